@@ -10,8 +10,6 @@
 
 #include <CKSDK/TTY.h>
 
-#include <memory>
-
 // Animation static functions
 KEEP uint32_t Character::Animation::GetFrameAt(const void *chr, uint32_t i, uint32_t j)
 {
@@ -19,8 +17,15 @@ KEEP uint32_t Character::Animation::GetFrameAt(const void *chr, uint32_t i, uint
 	const uint32_t *chrp = (const uint32_t*)chr + 1;
 	const uint16_t *codep = (const uint16_t*)((uintptr_t)chrp + chrp[i]);
 
-	// Decode frame code
-	return codep[j] & 0x1FF;
+	// Skip delta codes, which come before the frame they upload, so j only counts the other codes
+	while (1)
+	{
+		uint16_t code = *codep++;
+		if (((code >> 14) & 3) == 2) // Delta
+			continue;
+		if (j-- == 0)
+			return code & 0x1FF;
+	}
 }
 
 // Animation controller
@@ -35,6 +40,7 @@ KEEP void Character::Animation::Set(const void *chr, uint32_t i)
 
 	dma = true;
 	ended = false;
+	delta = 0;
 	timer = 0;
 	Tick(0);
 }
@@ -51,6 +57,7 @@ KEEP void Character::Animation::Tick(Timer::FixedTime time)
 			break;
 
 		// Process codes
+		uint32_t next_delta = 0;
 		while (1)
 		{
 			uint16_t code = *codep;
@@ -64,7 +71,10 @@ KEEP void Character::Animation::Tick(Timer::FixedTime time)
 				timer += Timer::FixedTime(1.0 / 24.0) * ((code >> 9) & 0x1F);
 				codep++;
 				if (next_frame != last_frame)
+				{
 					dma = true;
+					delta = next_delta;
+				}
 				break;
 			}
 			else
@@ -77,49 +87,195 @@ KEEP void Character::Animation::Tick(Timer::FixedTime time)
 						codep -= (code & 0x3FFF);
 						break;
 					}
+					case 2: // Delta
+					{
+						next_delta = code & 0x3FFF;
+						codep++;
+						break;
+					}
 				}
 			}
 		}
 	}
 }
 
-// Character static functions
-KEEP void Character::Draw(int32_t x, int32_t y, size_t ot, const void *msh, Color color)
+KEEP uint32_t Character::Animation::GetNextFrame() const
+{
+	// Follow the codes as Tick would, without changing state
+	const uint16_t *nextp = codep;
+	while (1)
+	{
+		uint16_t code = *nextp;
+		switch ((code >> 14) & 3)
+		{
+			case 0: // Frame
+				return code & 0x1FF;
+			case 1: // Back
+				nextp -= (code & 0x3FFF);
+				break;
+			case 2: // Delta
+				nextp++;
+				break;
+		}
+	}
+}
+
+// Transform
+bool Character::flat = false;
+
+KEEP void Character::SetTransform(const CKSDK::GPU::Matrix &mat, int32_t z)
 {
 	// Set GTE transform
-	gte_ldtx(x);
-	gte_ldty(y);
+	gte_SetRotMatrix(&mat);
+	gte_ldtz(z);
+
+	// Check if the transform only translates
+	flat = (z == g_screen_z);
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			if (mat.m[i][j] != ((i == j) ? 0x1000 : 0))
+				flat = false;
+}
 
-	// Get primitive word
-	uint32_t priw;
-	if (color == Color::White())
-		priw = (CKSDK::GPU::GP0_Poly | CKSDK::GPU::GP0_Poly_Quad | CKSDK::GPU::GP0_Poly_Tex | CKSDK::GPU::GP0_Poly_Raw | CKSDK::GPU::GP0_Poly_Semi) << 24; // 0x808080;
+inline bool Character::IsFlat(int32_t x, int32_t y, const MeshHeader &header)
+{
+	if (!flat)
+		return false;
+
+	// Check the screen space bounding box against the GTE's clamp
+	x += g_width / 2;
+	y += g_height / 2;
+	return (header.x0 + x) >= -0x400 && (header.x1 + x) <= 0x3FF && (header.y0 + y) >= -0x400 && (header.y1 + y) <= 0x3FF;
+}
+
+static inline uint32_t GetFlatOffset(int32_t x, int32_t y)
+{
+	// Pack the screen position of the mesh origin
+	return ((uint32_t)(y + (int32_t)(g_height / 2)) << 16) + (uint32_t)(x + (int32_t)(g_width / 2));
+}
+
+static inline CKSDK::GPU::Word GetFlatXY(const CKSDK::GPU::SVector &v, uint32_t offset)
+{
+	// The first word of a vector is its packed XY
+	// X is biased by 0x8000 so adding the offset never carries into Y, the GPU only reads its low 11 bits
+	return (*(const uint32_t*)&v ^ 0x8000) + offset;
+}
+
+// Culling
+static uint32_t culled = 0;
+
+KEEP uint32_t Character::GetCulled()
+{
+	return culled;
+}
+
+static inline bool IsOffScreen(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+	// Check if a screen space bounding box is entirely outside the screen
+	return x1 <= 0 || y1 <= 0 || x0 >= (int32_t)g_width || y0 >= (int32_t)g_height;
+}
+
+static inline bool IsOffScreen(const CKSDK::GPU::Word *xyp)
+{
+	// Get the bounding box of four transformed XY words, which are every other word
+	int32_t x0 = INT32_MAX, y0 = INT32_MAX, x1 = INT32_MIN, y1 = INT32_MIN;
+	for (int i = 0; i < 8; i += 2)
+	{
+		int32_t vx = (int16_t)xyp[i];
+		int32_t vy = (int32_t)xyp[i] >> 16;
+		if (vx < x0) x0 = vx;
+		if (vx > x1) x1 = vx;
+		if (vy < y0) y0 = vy;
+		if (vy > y1) y1 = vy;
+	}
+	return IsOffScreen(x0, y0, x1, y1);
+}
+
+static bool IsMeshOffScreen(const Character::MeshHeader &header, bool flat, int32_t x, int32_t y)
+{
+	// Translate the mesh's bounding box
+	if (flat)
+	{
+		x += g_width / 2;
+		y += g_height / 2;
+		return IsOffScreen(header.x0 + x, header.y0 + y, header.x1 + x, header.y1 + y);
+	}
+
+	// Transform the corners of the mesh's bounding box, the GTE translation must already be set
+	CKSDK::GPU::SVector corners[4] = {
+		{ header.x0, header.y0, 0, 0 },
+		{ header.x1, header.y0, 0, 0 },
+		{ header.x0, header.y1, 0, 0 },
+		{ header.x1, header.y1, 0, 0 },
+	};
+	CKSDK::GPU::Word xy[8];
+
+	gte_ldv3c(&corners[0]);
+	gte_rtpt();
+	gte_stsxy3(&xy[0], &xy[2], &xy[4]);
+
+	gte_ldv0(&corners[3]);
+	gte_rtps();
+	gte_stsxy2(&xy[6]);
+
+	return IsOffScreen(xy);
+}
+
+// Character static functions
+template <bool REMAP, bool FLAT>
+inline void Character::DrawPolys(int32_t x, int32_t y, MeshHeader header, const MeshPoly *mshp, uint32_t priw, uint32_t tpage, uint32_t clut, CKSDK::GPU::Word *&prip, CKSDK::GPU::Word *&linkp)
+{
+	// Set GTE transform
+	uint32_t offset = 0;
+	if (FLAT)
+	{
+		offset = GetFlatOffset(x, y);
+	}
 	else
-		priw = ((CKSDK::GPU::GP0_Poly | CKSDK::GPU::GP0_Poly_Quad | CKSDK::GPU::GP0_Poly_Tex | CKSDK::GPU::GP0_Poly_Semi) << 24) | color.c;
+	{
+		gte_ldtx(x);
+		gte_ldty(y);
+	}
 
-	// Get buffer pointers
-	CKSDK::GPU::Buffer *bufferp = CKSDK::GPU::g_bufferp;
+	// Cull the whole mesh
+	// A mesh of one poly is culled by the poly, which is cheaper than transforming its bounding box too
+	if ((FLAT || header.polys > 1) && IsMeshOffScreen(header, FLAT, x, y))
+	{
+		culled += header.polys;
+		return;
+	}
 
-	CKSDK::GPU::Word *prip = bufferp->prip;
-	CKSDK::GPU::Tag *otp = &bufferp->GetOT(ot);
-	CKSDK::GPU::Word *linkp = (CKSDK::GPU::Word*)otp->Ptr();
+	// Get remap words
+	// CLUT is the high half of the first word and tpage the high half of the second
+	uint32_t clut_mask = (clut != 0) ? 0xFFFF : 0xFFFFFFFF;
+	clut <<= 16;
+	tpage <<= 16;
 
-	// Get mesh pointer
-	MeshHeader header = *(const MeshHeader*)msh;
-	const MeshPoly *mshp = (const MeshPoly*)((uintptr_t)msh + sizeof(MeshHeader));
+	// Get flat screen offset of the polys' bounding boxes
+	int32_t sx = x + (int32_t)(g_width / 2);
+	int32_t sy = y + (int32_t)(g_height / 2);
 
 	// Transform and write primitives
-	while (header.polys-- > 0)
+	// Each primitive is only linked once it's known to be on screen
+	for (; header.polys != 0; header.polys--, mshp++)
 	{
-		// Link this primitive
-		new (prip) CKSDK::GPU::Tag(linkp, 9);
-		linkp = prip++;
-
-		// Load first 3 vectors
-		gte_ldv3c(&mshp->v[0]);
+		if (FLAT)
+		{
+			// Cull poly by its bounding box
+			if (IsOffScreen(mshp->v[0].pad + sx, mshp->v[1].pad + sy, mshp->v[2].pad + sx, mshp->v[3].pad + sy))
+			{
+				culled++;
+				continue;
+			}
+		}
+		else
+		{
+			// Load first 3 vectors
+			gte_ldv3c(&mshp->v[0]);
 
-		// Begin transform
-		gte_rtpt();
+			// Begin transform
+			gte_rtpt();
+		}
 
 		// Copy poly to primitive buffer
 		// Annoyingly, we have to coerce GCC into using two registers
@@ -127,31 +283,145 @@ KEEP void Character::Draw(int32_t x, int32_t y, size_t ot, const void *msh, Colo
 		// Oh well..
 		uint32_t c0, c1;
 
-		prip[0] = priw;
+		prip[1] = priw;
 
 		c0 = mshp->p[0];
 		c1 = mshp->p[1];
-		prip[2] = c0;
-		prip[4] = c1;
+		if (REMAP)
+		{
+			c0 = (c0 & clut_mask) | clut;
+			c1 += tpage;
+		}
+		prip[3] = c0;
+		prip[5] = c1;
 
 		c0 = mshp->p[2];
 		c1 = mshp->p[3];
-		prip[6] = c0;
-		prip[8] = c1;
+		prip[7] = c0;
+		prip[9] = c1;
 
-		// Read transformation result
-		gte_stsxy3(&prip[1], &prip[3], &prip[5]); // x0 y0 x1 y1 x2 y2
+		if (FLAT)
+		{
+			// Translate vertices
+			prip[2] = GetFlatXY(mshp->v[0], offset);
+			prip[4] = GetFlatXY(mshp->v[1], offset);
+			prip[6] = GetFlatXY(mshp->v[2], offset);
+			prip[8] = GetFlatXY(mshp->v[3], offset);
+		}
+		else
+		{
+			// Read transformation result
+			gte_stsxy3(&prip[2], &prip[4], &prip[6]); // x0 y0 x1 y1 x2 y2
 
-		// Transform last vertex
-		gte_ldv0(&mshp->v[3]);
-		gte_rtps();
+			// Transform last vertex
+			gte_ldv0(&mshp->v[3]);
+			gte_rtps();
 
-		// Increment pointers
-		prip += 9;
-		mshp++;
+			// Read transformation result
+			gte_stsxy2(&prip[8]);
+
+			// Cull poly by its transformed vertices
+			if (IsOffScreen(&prip[2]))
+			{
+				culled++;
+				continue;
+			}
+		}
 
-		// Read transformation result
-		gte_stsxy2(&prip[7 - 9]);
+		// Link this primitive
+		new (prip) CKSDK::GPU::Tag(linkp, 9);
+		linkp = prip;
+		prip += 10;
+	}
+}
+
+template <bool REMAP, bool RAW, bool FLAT>
+inline void Character::DrawMesh(int32_t x, int32_t y, size_t ot, const void *msh, Color color, uint32_t tpage, uint32_t clut)
+{
+	// Get buffer pointers
+	CKSDK::GPU::Buffer *bufferp = CKSDK::GPU::g_bufferp;
+
+	CKSDK::GPU::Word *prip = bufferp->prip;
+	CKSDK::GPU::Tag *otp = &bufferp->GetOT(ot);
+	CKSDK::GPU::Word *linkp = (CKSDK::GPU::Word*)otp->Ptr();
+
+	// Get mesh pointer
+	MeshHeader header = *(const MeshHeader*)msh;
+	const MeshPoly *mshp = (const MeshPoly*)((uintptr_t)msh + sizeof(MeshHeader));
+
+	// Write primitives
+	DrawPolys<REMAP, FLAT>(x, y, header, mshp, GetPrimitiveWord<RAW>(color), tpage, clut, prip, linkp);
+
+	// Link primitives
+	bufferp->prip = prip;
+	new (otp) CKSDK::GPU::Tag(linkp, 0);
+}
+
+KEEP void Character::Draw(int32_t x, int32_t y, size_t ot, const void *msh, Color color)
+{
+	if (IsFlat(x, y, *(const MeshHeader*)msh))
+	{
+		if (color == Color::White())
+			DrawMesh<false, true, true>(x, y, ot, msh, color, 0, 0);
+		else
+			DrawMesh<false, false, true>(x, y, ot, msh, color, 0, 0);
+	}
+	else
+	{
+		if (color == Color::White())
+			DrawMesh<false, true, false>(x, y, ot, msh, color, 0, 0);
+		else
+			DrawMesh<false, false, false>(x, y, ot, msh, color, 0, 0);
+	}
+}
+
+KEEP void Character::Draw(int32_t x, int32_t y, size_t ot, const void *msh, Color color, const TexCache::Remap &remap)
+{
+	if (remap.tpage == 0 && remap.clut == 0)
+		Draw(x, y, ot, msh, color);
+	else if (IsFlat(x, y, *(const MeshHeader*)msh))
+	{
+		if (color == Color::White())
+			DrawMesh<true, true, true>(x, y, ot, msh, color, remap.tpage, remap.clut);
+		else
+			DrawMesh<true, false, true>(x, y, ot, msh, color, remap.tpage, remap.clut);
+	}
+	else
+	{
+		if (color == Color::White())
+			DrawMesh<true, true, false>(x, y, ot, msh, color, remap.tpage, remap.clut);
+		else
+			DrawMesh<true, false, false>(x, y, ot, msh, color, remap.tpage, remap.clut);
+	}
+}
+
+KEEP void Character::DrawInstances(const void *msh, const CKSDK::GPU::ScreenCoord *positions, size_t count, size_t ot, const Color *colors)
+{
+	// Get buffer pointers
+	CKSDK::GPU::Buffer *bufferp = CKSDK::GPU::g_bufferp;
+
+	CKSDK::GPU::Word *prip = bufferp->prip;
+	CKSDK::GPU::Tag *otp = &bufferp->GetOT(ot);
+	CKSDK::GPU::Word *linkp = (CKSDK::GPU::Word*)otp->Ptr();
+
+	// Get mesh pointer
+	MeshHeader header = *(const MeshHeader*)msh;
+	const MeshPoly *mshp = (const MeshPoly*)((uintptr_t)msh + sizeof(MeshHeader));
+
+	// Write every instance's primitives into one chain
+	uint32_t priw = GetPrimitiveWord<true>(Color::White());
+	for (size_t i = 0; i < count; i++)
+	{
+		int32_t x = positions[i].s.x;
+		int32_t y = positions[i].s.y;
+
+		if (colors != nullptr)
+			priw = (colors[i] == Color::White()) ? GetPrimitiveWord<true>(colors[i]) : GetPrimitiveWord<false>(colors[i]);
+
+		if (IsFlat(x, y, header))
+			DrawPolys<false, true>(x, y, header, mshp, priw, 0, 0, prip, linkp);
+		else
+			DrawPolys<false, false>(x, y, header, mshp, priw, 0, 0, prip, linkp);
 	}
 
 	// Link primitives
@@ -159,12 +429,127 @@ KEEP void Character::Draw(int32_t x, int32_t y, size_t ot, const void *msh, Colo
 	new (otp) CKSDK::GPU::Tag(linkp, 0);
 }
 
-KEEP void Character::DMA(const void *dma)
+// Packet template
+KEEP void Character::Template::Draw(int32_t x, int32_t y, size_t ot, const void *msh, Color color)
+{
+	// Get buffer pointers
+	CKSDK::GPU::Buffer *bufferp = CKSDK::GPU::g_bufferp;
+	CKSDK::GPU::Tag *otp = &bufferp->GetOT(ot);
+
+	// Get this frame buffer's packets, the other buffer's may still be being drawn
+	Packets *packetsp;
+	if (packets[0].bufferp == bufferp)
+		packetsp = &packets[0];
+	else if (packets[1].bufferp == bufferp || packets[0].bufferp != nullptr)
+		packetsp = &packets[1];
+	else
+		packetsp = &packets[0];
+	packetsp->bufferp = bufferp;
+
+	// Get mesh pointer
+	MeshHeader header = *(const MeshHeader*)msh;
+	const MeshPoly *mshp = (const MeshPoly*)((uintptr_t)msh + sizeof(MeshHeader));
+
+	if (header.polys == 0)
+		return;
+
+	// Cull the whole mesh
+	bool flat = IsFlat(x, y, header);
+	if (!flat)
+	{
+		// Set GTE transform
+		gte_ldtx(x);
+		gte_ldty(y);
+	}
+
+	if (IsMeshOffScreen(header, flat, x, y))
+	{
+		culled += header.polys;
+		return;
+	}
+
+	if (packetsp->msh != msh || !(packetsp->color == color))
+	{
+		// Build packets
+		if (header.polys > packetsp->capacity)
+		{
+			packetsp->words.reset(new CKSDK::GPU::Word[header.polys * 10]);
+			packetsp->capacity = header.polys;
+		}
+
+		uint32_t priw = (color == Color::White()) ? GetPrimitiveWord<true>(color) : GetPrimitiveWord<false>(color);
+
+		CKSDK::GPU::Word *prip = packetsp->words.get();
+		for (uint32_t i = 0; i < header.polys; i++)
+		{
+			if (i != 0)
+				new (prip) CKSDK::GPU::Tag(prip - 10, 9);
+			prip[1] = priw;
+			prip[3] = mshp[i].p[0];
+			prip[5] = mshp[i].p[1];
+			prip[7] = mshp[i].p[2];
+			prip[9] = mshp[i].p[3];
+			prip += 10;
+		}
+
+		packetsp->msh = msh;
+		packetsp->color = color;
+		packetsp->polys = header.polys;
+	}
+
+	// Transform into the packets' XY words
+	CKSDK::GPU::Word *prip = packetsp->words.get();
+	if (flat)
+	{
+		uint32_t offset = GetFlatOffset(x, y);
+		for (uint32_t i = 0; i < header.polys; i++)
+		{
+			// Translate vertices
+			prip[2] = GetFlatXY(mshp->v[0], offset);
+			prip[4] = GetFlatXY(mshp->v[1], offset);
+			prip[6] = GetFlatXY(mshp->v[2], offset);
+			prip[8] = GetFlatXY(mshp->v[3], offset);
+
+			// Increment pointers
+			prip += 10;
+			mshp++;
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < header.polys; i++)
+		{
+			// Transform first 3 vertices
+			gte_ldv3c(&mshp->v[0]);
+			gte_rtpt();
+			gte_stsxy3(&prip[2], &prip[4], &prip[6]); // x0 y0 x1 y1 x2 y2
+
+			// Transform last vertex
+			gte_ldv0(&mshp->v[3]);
+			gte_rtps();
+
+			// Increment pointers
+			prip += 10;
+			mshp++;
+
+			// Read transformation result
+			gte_stsxy2(&prip[8 - 10]);
+		}
+	}
+
+	// Link packets
+	new (packetsp->words.get()) CKSDK::GPU::Tag((CKSDK::GPU::Word*)otp->Ptr(), 9);
+	new (otp) CKSDK::GPU::Tag(prip - 10, 0);
+}
+
+KEEP Upload::Fence Character::DMA(const void *dma, uint32_t offset, uint32_t clut)
 {
 	// Process DMAs
 	const char *dmap = (const char*)dma;
 	const uint32_t *dmad = (const uint32_t*)dma;
 
+	Upload::Fence fence = 0;
+
 	uint32_t dmas = *dmad++;
 	for (; dmas != 0; dmas--)
 	{
@@ -177,20 +562,19 @@ KEEP void Character::DMA(const void *dma)
 		uint32_t wh = dmad[5];
 		dmad += 6;
 
+		// Move images by offset, and the palette (always the last DMA) to clut
+		if (dmas != 1)
+			xy += offset;
+		else if (clut != 0)
+			xy = clut;
+
+		// Queue image, compressed bands are decoded while the one before is sent
 		if (compress != 0)
-		{
-			// Decompress image
-			std::unique_ptr<char[]> decbuf(new char[compress]);
-			Compress::Decompress(dmap + poff, decbuf.get());
-			CKSDK::GPU::DMAImage(decbuf.get(), xy, wh, bcr);
-			CKSDK::GPU::QueueSync();
-		}
+			fence = Upload::Band(dmap + poff, compress, xy, wh, bcr);
 		else
-		{
-			// Direct DMA image
-			CKSDK::GPU::DMAImage(dmap + poff, xy, wh, bcr);
-		}
+			fence = Upload::Image(dmap + poff, xy, wh, bcr);
 	}
+	return fence;
 }
 
 // Sprite static functions
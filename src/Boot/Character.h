@@ -14,6 +14,10 @@
 
 #include "Boot/Timer.h"
 #include "Boot/Compress.h"
+#include "Boot/Upload.h"
+#include "Boot/TexCache.h"
+
+#include <memory>
 
 // Color helper
 struct Color
@@ -50,11 +54,13 @@ class Character
 
 				uint32_t animation;
 				uint32_t frame;
+				uint32_t delta; // Delta upload from the previous frame to this one, or 0
 
 				bool dma, ended;
 
 			public:
 				// Static animation functions
+				// j indexes the animation's codes with its delta codes skipped
 				static uint32_t GetFrameAt(const void *chr, uint32_t i, uint32_t j);
 				static const void *GetMeshAt(const void *chr, uint32_t i, uint32_t j)
 				{
@@ -68,6 +74,8 @@ class Character
 				void Tick(Timer::FixedTime time);
 				
 				uint32_t GetFrame() const { return frame; }
+				uint32_t GetNextFrame() const; // Frame shown once this one's timer runs out
+				uint32_t GetDelta() const { return delta; }
 				
 				void SetEnded() { ended = true; }
 				bool GetEnded() const { return ended; }
@@ -79,8 +87,11 @@ class Character
 		struct MeshHeader
 		{
 			uint32_t polys;
+			int16_t x0, y0, x1, y1; // Bounding box of every poly
 		};
-		static_assert(sizeof(MeshHeader) == 4);
+		static_assert(sizeof(MeshHeader) == 12);
+		// Each poly's own bounding box is kept in the pads of its vertices, which the GTE doesn't read,
+		// as v[0].pad = x0, v[1].pad = y0, v[2].pad = x1 and v[3].pad = y1
 		struct MeshPoly
 		{
 			union
@@ -102,19 +113,89 @@ class Character
 		};
 		static_assert(sizeof(MeshPoly) == (4 * (4 + (4 * 2))));
 
+		// Packet template
+		// A mesh's primitives built once per frame buffer with their constant words in place, each linked to the one before,
+		// so drawing it again only writes the transformed XY words and links the first primitive into the OT
+		// Each template must only be drawn once a frame, and is rebuilt whenever its mesh or colour changes
+		// Templates are culled as a whole, their polys stay linked to each other
+		class Template
+		{
+			private:
+				struct Packets
+				{
+					const CKSDK::GPU::Buffer *bufferp = nullptr;
+					const void *msh = nullptr;
+					Color color;
+
+					uint32_t polys = 0, capacity = 0;
+					std::unique_ptr<CKSDK::GPU::Word[]> words;
+				};
+				Packets packets[2];
+
+			public:
+				// Template functions
+				void Draw(int32_t x, int32_t y, size_t ot, const void *msh, Color color);
+				void Draw(int32_t x, int32_t y, size_t ot, const void *chr, uint32_t frame, Color color)
+				{
+					// Draw mesh
+					Draw(x, y, ot, GetMesh(chr, frame), color);
+				}
+		};
+
 	private:
 		// Assigned character and animation
 		const void *chr;
 		Animation animation;
 
+		// Last uploaded DMA
+		const void *dma_last = nullptr;
+
+		// Transform state
+		// Set when the transform only translates, so meshes can be drawn without the GTE
+		static bool flat;
+
+		// The GTE clamps screen coordinates to +-1024, so a mesh is only drawn flat when its bounding box
+		// stays inside that range at the given position, and integer adds give the vertices the GTE would
+		static bool IsFlat(int32_t x, int32_t y, const MeshHeader &header);
+
+		// Mesh drawing, with REMAP moving each poly's tpage and CLUT to a texture cache slot
+		// RAW draws untinted, without a colour
+		// FLAT adds the position to the vertices instead of transforming them
+		template <bool REMAP, bool FLAT>
+		static void DrawPolys(int32_t x, int32_t y, MeshHeader header, const MeshPoly *mshp, uint32_t priw, uint32_t tpage, uint32_t clut, CKSDK::GPU::Word *&prip, CKSDK::GPU::Word *&linkp);
+		template <bool REMAP, bool RAW, bool FLAT>
+		static void DrawMesh(int32_t x, int32_t y, size_t ot, const void *msh, Color color, uint32_t tpage, uint32_t clut);
+		template <bool RAW>
+		static uint32_t GetPrimitiveWord(Color color)
+		{
+			if (RAW)
+				return (CKSDK::GPU::GP0_Poly | CKSDK::GPU::GP0_Poly_Quad | CKSDK::GPU::GP0_Poly_Tex | CKSDK::GPU::GP0_Poly_Raw | CKSDK::GPU::GP0_Poly_Semi) << 24;
+			else
+				return ((CKSDK::GPU::GP0_Poly | CKSDK::GPU::GP0_Poly_Quad | CKSDK::GPU::GP0_Poly_Tex | CKSDK::GPU::GP0_Poly_Semi) << 24) | color.c;
+		}
+
 	public:
 		// Constructor
 		Character() {}
 		Character(const void *chr) : chr(chr) {}
-		Character &operator=(const void *chr) { this->chr = chr; return *this; }
+		Character &operator=(const void *chr) { this->chr = chr; dma_last = nullptr; return *this; }
+
+		// Transform
+		// Sets the GTE rotation and z translation of the draws after it
+		// The identity matrix at g_screen_z is a plain 2D translation, which is drawn with integer adds
+		static void SetTransform(const CKSDK::GPU::Matrix &mat, int32_t z);
+
+		// Culling
+		// Meshes and polys entirely outside the screen aren't drawn
+		static uint32_t GetCulled(); // Polys culled, including those of whole meshes
 
 		// Static character functions
 		static void Draw(int32_t x, int32_t y, size_t ot, const void *msh, Color color);
+		static void Draw(int32_t x, int32_t y, size_t ot, const void *msh, Color color, const TexCache::Remap &remap);
+
+		// Draws a mesh at every position into one OT chain, only reading the mesh header and OT entry once
+		// colors is one per instance, or nullptr to draw them all untinted
+		static void DrawInstances(const void *msh, const CKSDK::GPU::ScreenCoord *positions, size_t count, size_t ot, const Color *colors = nullptr);
 		
 		static const void *GetMesh(const void *chr, uint32_t frame)
 		{
@@ -130,21 +211,40 @@ class Character
 			Draw(x, y, ot, GetMesh(chr, frame), color);
 		}
 
-		static void DMA(const void *dma);
-		static void DMA(const void *chr, uint32_t frame)
+		// offset is added to the position of each image, clut moves the palette if not 0
+		// Returns the fence of the last transfer, which the DMA's memory must outlive
+		static Upload::Fence DMA(const void *dma, uint32_t offset, uint32_t clut);
+		static Upload::Fence DMA(const void *dma) { return DMA(dma, 0, 0); }
+		static const void *GetDMA(const void *chr, uint32_t frame)
 		{
 			// Get DMA pointer
+			// Identical frames share one DMA, so this is also the frame's texture identity
 			const uint32_t *chrp = (const uint32_t*)chr;
 			chrp = (const uint32_t*)((uintptr_t)chrp + chrp[0]);
 
 			uint32_t dmao = chrp[frame * 2 + 1];
 			if (dmao == 0)
-				return;
-
-			const uint32_t *dmap = (const uint32_t*)((uintptr_t)chrp + dmao);
+				return nullptr;
+			return (const void*)((uintptr_t)chrp + dmao);
+		}
 
+		static Upload::Fence DMA(const void *chr, uint32_t frame, uint32_t offset, uint32_t clut)
+		{
 			// Issue DMA
-			DMA(dmap);
+			const void *dmap = GetDMA(chr, frame);
+			if (dmap == nullptr)
+				return 0;
+			return DMA(dmap, offset, clut);
+		}
+		static Upload::Fence DMA(const void *chr, uint32_t frame) { return DMA(chr, frame, 0, 0); }
+
+		static uint32_t GetDeltaBase(const void *chr, uint32_t delta)
+		{
+			// Get the frame a delta upload applies over
+			// Deltas are extra entries after the frames, with their base frame in place of a mesh
+			const uint32_t *chrp = (const uint32_t*)chr;
+			chrp = (const uint32_t*)((uintptr_t)chrp + chrp[0]);
+			return chrp[delta * 2];
 		}
 
 		// Character functions
@@ -180,10 +280,38 @@ class Character
 
 		void Draw(int32_t x, int32_t y, size_t ot, Color color = Color::White())
 		{
+			uint32_t frame = animation.GetFrame();
+			bool dma = animation.DMA();
+
+			// Draw character from the texture cache if it has a pool
+			TexCache::Remap remap;
+			if (TexCache::Use(chr, frame, dma, remap))
+			{
+				Draw(x, y, ot, GetMesh(chr, frame), color, remap);
+
+				// Upload the next frame while this one holds, so changing to it doesn't have to
+				if (!dma)
+					TexCache::Prefetch(chr, animation.GetNextFrame());
+				return;
+			}
+
 			// Draw character
-			if (animation.DMA())
-				DMA(chr, animation.GetFrame());
-			Draw(x, y, ot, chr, animation.GetFrame(), color);
+			// Frames that share a DMA don't need to be uploaded again
+			// Stepping from the frame a delta was made against only uploads what changed
+			if (dma)
+			{
+				const void *dmap = GetDMA(chr, frame);
+				if (dmap != dma_last && dmap != nullptr)
+				{
+					uint32_t delta = animation.GetDelta();
+					if (delta != 0 && dma_last != nullptr && dma_last == GetDMA(chr, GetDeltaBase(chr, delta)))
+						DMA(chr, delta);
+					else
+						DMA(dmap);
+				}
+				dma_last = dmap;
+			}
+			Draw(x, y, ot, chr, frame, color);
 		}
 };
 
@@ -195,6 +323,9 @@ class Sprite
 		const void *spr;
 		Character::Animation animation;
 
+		// Last uploaded DMA
+		const void *dma_last = nullptr;
+
 		// Sprite structures
 		struct SpriteHeader
 		{
@@ -221,7 +352,7 @@ class Sprite
 		// Constructor
 		Sprite() {}
 		Sprite(const void *spr) : spr(spr) {}
-		Sprite &operator=(const void *spr) { this->spr = spr; return *this; }
+		Sprite &operator=(const void *spr) { this->spr = spr; dma_last = nullptr; return *this; }
 
 		// Static sprite functions
 		static void Draw(int32_t x, int32_t y, size_t ot, const void *spr, Color color);
@@ -240,8 +371,9 @@ class Sprite
 			Draw(x, y, ot, GetSprite(spr, frame), color);
 		}
 
-		static void DMA(const void *dma) { Character::DMA(dma); }
-		static void DMA(const void *chr, uint32_t frame) { Character::DMA(chr, frame); }
+		static Upload::Fence DMA(const void *dma) { return Character::DMA(dma); }
+		static Upload::Fence DMA(const void *chr, uint32_t frame) { return Character::DMA(chr, frame); }
+		static const void *GetDMA(const void *spr, uint32_t frame) { return Character::GetDMA(spr, frame); }
 
 		// Sprite functions
 		void SetAnimation(uint32_t i)
@@ -277,8 +409,14 @@ class Sprite
 		void Draw(int32_t x, int32_t y, size_t ot, Color color = Color::White())
 		{
 			// Draw character
+			// Frames that share a DMA don't need to be uploaded again
 			if (animation.DMA())
-				DMA(spr, animation.GetFrame());
+			{
+				const void *dmap = GetDMA(spr, animation.GetFrame());
+				if (dmap != dma_last && dmap != nullptr)
+					DMA(dmap);
+				dma_last = dmap;
+			}
 			Draw(x, y, ot, spr, animation.GetFrame(), color);
 		}
 };
@@ -138,4 +138,139 @@ namespace Compress
 			.set reorder
 		)" ::: "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7", "t8", "t9", "a0", "a1");
 	}
+
+	KEEP void DecompressLZB(const void *in, void *out)
+	{
+		// LZB, see tools/lib/clownlzss/lzb.h
+		// DMA::DecodeCycles counts the instructions on each path, keep it in step
+		INLINE_ASM(R"(
+			# a0 = in
+			# a1 = out
+			#
+			# t0 = match length
+			# t1 = literal length
+			# t2 = match offset
+			# t3 = temporary
+			# t4 = match source
+			# t5 = copied word or byte
+			# t6 = length extension byte
+			# t7 = 15
+			# t8 = 255
+
+			.set noreorder
+
+				li    $t7, 15
+				li    $t8, 255
+
+			.Llzb_sequence:
+				lbu   $t0, 0($a0)      # Fetch token
+				addiu $a0, 1
+				srl   $t1, $t0, 4      # Literal length in the high nibble
+				beqz  $t1, .Llzb_offset
+				andi  $t0, 15          # Match length in the low nibble
+				bne   $t1, $t7, .Llzb_literals
+				nop
+
+			.Llzb_literal_extend:
+				lbu   $t6, 0($a0)      # Add extension bytes until one isn't 255
+				addiu $a0, 1
+				addu  $t1, $t6
+				beq   $t6, $t8, .Llzb_literal_extend
+				nop
+
+			.Llzb_literals:
+				sltiu $t3, $t1, 4
+				bnez  $t3, .Llzb_literal_bytes
+				nop
+			.Llzb_literal_words:
+				lwl   $t5, 3($a0)      # Copy literals a word at a time, neither side is aligned
+				lwr   $t5, 0($a0)
+				addiu $t1, -4
+				swl   $t5, 3($a1)
+				swr   $t5, 0($a1)
+				sltiu $t3, $t1, 4
+				addiu $a0, 4
+				beqz  $t3, .Llzb_literal_words
+				addiu $a1, 4
+				beqz  $t1, .Llzb_offset
+				nop
+			.Llzb_literal_bytes:
+				lbu   $t5, 0($a0)      # Copy the rest a byte at a time
+				addiu $a0, 1
+				addiu $t1, -1
+				sb    $t5, 0($a1)
+				bnez  $t1, .Llzb_literal_bytes
+				addiu $a1, 1
+
+			.Llzb_offset:
+				lbu   $t2, 0($a0)      # Fetch little endian offset
+				lbu   $t3, 1($a0)
+				addiu $a0, 2
+				sll   $t3, 8
+				or    $t2, $t3
+				beqz  $t2, .Llzb_end       # An offset of 0 ends the stream
+				subu  $t4, $a1, $t2    # Get match source
+				bne   $t0, $t7, .Llzb_match
+				addiu $t0, 4           # Matches are at least 4 bytes
+
+			.Llzb_match_extend:
+				lbu   $t6, 0($a0)      # Add extension bytes until one isn't 255
+				addiu $a0, 1
+				addu  $t0, $t6
+				beq   $t6, $t8, .Llzb_match_extend
+				nop
+
+			.Llzb_match:
+				sltiu $t3, $t2, 4      # Offsets under 4 overlap the word being copied
+				bnez  $t3, .Llzb_match_near
+				nop
+			.Llzb_match_words:
+				lwl   $t5, 3($t4)      # Copy match a word at a time
+				lwr   $t5, 0($t4)
+				addiu $t0, -4
+				swl   $t5, 3($a1)
+				swr   $t5, 0($a1)
+				sltiu $t3, $t0, 4
+				addiu $t4, 4
+				beqz  $t3, .Llzb_match_words
+				addiu $a1, 4
+				beqz  $t0, .Llzb_sequence
+				nop
+			.Llzb_match_bytes:
+				lbu   $t5, 0($t4)      # Copy the rest a byte at a time
+				addiu $t4, 1
+				addiu $t0, -1
+				sb    $t5, 0($a1)
+				bnez  $t0, .Llzb_match_bytes
+				addiu $a1, 1
+				b     .Llzb_sequence
+				nop
+
+			.Llzb_match_near:
+				sltiu $t3, $t2, 3      # An offset of 3 doesn't repeat within a word
+				beqz  $t3, .Llzb_match_bytes
+				nop
+				lbu   $t5, 0($t4)      # Offsets of 1 and 2 do, so fill with the repeated word
+				lbu   $t6, -1($a1)
+				nop
+				sll   $t6, 8
+				or    $t5, $t6
+				sll   $t6, $t5, 16
+				or    $t5, $t6
+			.Llzb_match_fill:
+				addiu $t0, -4
+				swl   $t5, 3($a1)
+				swr   $t5, 0($a1)
+				sltiu $t3, $t0, 4
+				beqz  $t3, .Llzb_match_fill
+				addiu $a1, 4
+				bnez  $t0, .Llzb_match_bytes
+				subu  $t4, $a1, $t2    # Copy the rest from where the fill stopped
+				b     .Llzb_sequence
+				nop
+
+			.Llzb_end:
+			.set reorder
+		)" ::: "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7", "t8", "a0", "a1");
+	}
 }
@@ -12,6 +12,14 @@
 
 namespace Compress
 {
+	// A DMA's compress field is its decompressed size, with LZB set if it's LZB rather than Comper
+	static constexpr uint32_t LZB = 0x10000000;
+	static constexpr uint32_t SIZE = 0x0FFFFFFF;
+
+	// Compressed DMAs are row bands decompressing to at most this many bytes, see STREAM_BAND_SIZE in FunkinAlgo.h
+	static constexpr uint32_t BAND_SIZE = 0x2000;
+
 	// Decompression functions
 	void Decompress(const void *in, void *out);
+	void DecompressLZB(const void *in, void *out);
 }
@@ -93,7 +93,7 @@ extern "C" void main()
 
 	// Setup GTE for 2D screen
 	gte_SetGeomOffset(g_width / 2, g_height / 2);
-	gte_SetGeomScreen(256);
+	gte_SetGeomScreen(g_screen_z);
 
 	// Initialize random seed
 	Random::Seed(CKSDK::OS::TimerCtrl(2).value);
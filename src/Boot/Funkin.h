@@ -17,6 +17,7 @@
 // Funkin globals
 static constexpr uint32_t g_width = 320;
 static constexpr uint32_t g_height = 240;
+static constexpr int32_t g_screen_z = 256; // GTE projection distance, drawn at 1:1 scale
 
 enum OT
 {
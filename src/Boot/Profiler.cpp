@@ -10,6 +10,8 @@
 
 #ifdef ENABLE_PROFILER
 #include "Boot/Timer.h"
+#include "Boot/TexCache.h"
+#include "Boot/Character.h"
 
 #include <CKSDK/GPU.h>
 #include <CKSDK/Mem.h>
@@ -25,6 +27,7 @@ namespace Profiler
 	static constexpr Timer::FixedTime BAR_TIME = 1.0 / 30.0;
 
 	static Timer::FixedTime start_time = 0;
+	static uint32_t culled_last = 0;
 
 	// Profiler functions
 	KEEP void StartFrame()
@@ -74,6 +77,22 @@ namespace Profiler
 		CKSDK::TTY::Out(" (");
 		CKSDK::TTY::OutHex<4>(mem_blocks);
 		CKSDK::TTY::Out(")\n");
+
+		// Texture cache profile
+		CKSDK::TTY::Out("TexCache ");
+		CKSDK::TTY::OutHex<4>(TexCache::GetHits());
+		CKSDK::TTY::Out(" hits ");
+		CKSDK::TTY::OutHex<4>(TexCache::GetMisses());
+		CKSDK::TTY::Out(" misses ");
+		CKSDK::TTY::OutHex<4>(TexCache::GetPrefetches());
+		CKSDK::TTY::Out(" prefetches\n");
+
+		// Culling profile
+		uint32_t culled = Character::GetCulled();
+		CKSDK::TTY::Out("Culled ");
+		CKSDK::TTY::OutHex<4>(culled - culled_last);
+		CKSDK::TTY::Out(" polys\n");
+		culled_last = culled;
 	}
 }
 #endif
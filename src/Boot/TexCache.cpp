@@ -0,0 +1,172 @@
+/*
+	[ Funkin ]
+	Copyright Regan "CKDEV" Green 2023-2025
+
+	- TexCache.cpp -
+	Character frame texture cache
+*/
+
+#include "Boot/TexCache.h"
+
+#include "Boot/Character.h"
+
+#include <CKSDK/ExScreen.h>
+
+namespace TexCache
+{
+	// Cache state
+	struct Entry
+	{
+		const void *chr;
+		Slot slot;
+
+		const void *dma; // Resident frame's DMA, identical frames share one
+		uint32_t used; // Tick of last use
+	};
+
+	static Entry entries[MAX_SLOTS];
+	static size_t entry_count = 0;
+
+	static uint32_t tick = 0;
+	static uint32_t hits = 0, misses = 0, prefetches = 0;
+
+	// Cache functions
+	static void AddEntry(const void *chr, Slot slot)
+	{
+		if (entry_count >= MAX_SLOTS)
+			CKSDK::ExScreen::Abort("TexCache::AddPool out of slots");
+
+		Entry &entry = entries[entry_count++];
+		entry.chr = chr;
+		entry.slot = slot;
+		entry.dma = nullptr;
+		entry.used = 0;
+	}
+
+	KEEP void Reset()
+	{
+		// Forget every pool
+		entry_count = 0;
+		tick = 0;
+		hits = 0;
+		misses = 0;
+		prefetches = 0;
+	}
+
+	KEEP void AddPool(const void *chr, const Slot *slots, size_t n)
+	{
+		// The character's own slot is always part of its pool
+		AddEntry(chr, Slot{ 0, 0, 0, 0 });
+		for (size_t i = 0; i < n; i++)
+			AddEntry(chr, slots[i]);
+	}
+
+	KEEP bool Use(const void *chr, uint32_t frame, bool changed, Remap &remap)
+	{
+		// Frames without a texture draw as they are
+		const void *dma = Character::GetDMA(chr, frame);
+		if (dma == nullptr)
+		{
+			remap.tpage = 0;
+			remap.clut = 0;
+			return true;
+		}
+
+		// Find the frame or the least recently used slot of the character's pool
+		Entry *resident = nullptr, *lru = nullptr;
+		for (size_t i = 0; i < entry_count; i++)
+		{
+			Entry &entry = entries[i];
+			if (entry.chr != chr)
+				continue;
+
+			if (entry.dma == dma)
+			{
+				resident = &entry;
+				break;
+			}
+			if (lru == nullptr || entry.used < lru->used)
+				lru = &entry;
+		}
+
+		if (resident != nullptr)
+		{
+			// Only count frame changes, not every draw of the same frame
+			if (changed)
+				hits++;
+		}
+		else
+		{
+			if (lru == nullptr)
+				return false;
+
+			// Upload the frame into the evicted slot
+			// The slot drawn last frame is the most recently used, so the GPU is never still reading the evicted one
+			uint32_t offset = ((uint32_t)(uint16_t)lru->slot.dy << 16) | (uint16_t)lru->slot.dx;
+			uint32_t clut = ((uint32_t)(uint16_t)lru->slot.cy << 16) | (uint16_t)lru->slot.cx;
+			Character::DMA(dma, offset, clut);
+
+			resident = lru;
+			resident->dma = dma;
+			misses++;
+		}
+
+		// Get remap
+		resident->used = ++tick;
+
+		remap.tpage = (resident->slot.dx >> 6) | ((resident->slot.dy >> 8) << 4);
+		remap.clut = (resident->slot.cx != 0 || resident->slot.cy != 0) ? ((resident->slot.cy << 6) | (resident->slot.cx >> 4)) : 0;
+		return true;
+	}
+
+	KEEP void Prefetch(const void *chr, uint32_t frame)
+	{
+		// Frames without a texture don't need uploading
+		const void *dma = Character::GetDMA(chr, frame);
+		if (dma == nullptr)
+			return;
+
+		// Find the frame, or the least recently used slot that isn't the shown frame's
+		Entry *lru = nullptr, *mru = nullptr;
+		for (size_t i = 0; i < entry_count; i++)
+		{
+			Entry &entry = entries[i];
+			if (entry.chr != chr)
+				continue;
+
+			if (entry.dma == dma)
+				return;
+			if (lru == nullptr || entry.used < lru->used)
+				lru = &entry;
+			if (mru == nullptr || entry.used > mru->used)
+				mru = &entry;
+		}
+		if (lru == mru)
+			return;
+
+		// Upload the frame into the evicted slot
+		// Its tick isn't touched, so a frame the animation never reaches is the first to go again
+		uint32_t offset = ((uint32_t)(uint16_t)lru->slot.dy << 16) | (uint16_t)lru->slot.dx;
+		uint32_t clut = ((uint32_t)(uint16_t)lru->slot.cy << 16) | (uint16_t)lru->slot.cx;
+		Character::DMA(dma, offset, clut);
+
+		lru->dma = dma;
+		prefetches++;
+	}
+
+	// Statistics
+	KEEP uint32_t GetHits()
+	{
+		return hits;
+	}
+
+	KEEP uint32_t GetMisses()
+	{
+		return misses;
+	}
+
+	KEEP uint32_t GetPrefetches()
+	{
+		return prefetches;
+	}
+}
@@ -0,0 +1,53 @@
+/*
+	[ Funkin ]
+	Copyright Regan "CKDEV" Green 2023-2025
+
+	- TexCache.h -
+	Character frame texture cache
+*/
+
+#pragma once
+
+#include "Boot/Funkin.h"
+
+namespace TexCache
+{
+	// Cache structures
+	// A slot is a copy of a character's own texture slot moved by whole texture pages,
+	// so its frames keep their UVs and only the tpage changes
+	struct Slot
+	{
+		int16_t dx, dy; // Multiples of 64 and 256
+		int16_t cx, cy; // CLUT position, or 0 to share the character's own CLUT (singleclut only)
+	};
+
+	// How a resident frame's mesh must be drawn
+	struct Remap
+	{
+		uint32_t tpage; // Added to each poly's tpage
+		uint32_t clut;  // Replaces each poly's CLUT if not 0
+	};
+
+	static constexpr size_t MAX_SLOTS = 32;
+
+	// Cache functions
+	// A character's pool is its own texture slot plus the given spare slots
+	void Reset();
+	void AddPool(const void *chr, const Slot *slots, size_t n);
+
+	// Makes the frame resident, uploading it into the least recently used slot on a miss
+	// Frames are keyed by their DMA, so frames the compiler shared are one entry
+	// Called every draw, changed tells whether the frame changed since the last one
+	// Returns false if the character has no pool, in which case it's uploaded as usual
+	bool Use(const void *chr, uint32_t frame, bool changed, Remap &remap);
+
+	// Uploads a frame the character will show next into its least recently used slot, ahead of Use
+	// Only called on draws where the shown frame didn't change, so the GPU isn't reading any other slot
+	// A pool of one slot, which is always the shown frame's, doesn't prefetch
+	void Prefetch(const void *chr, uint32_t frame);
+
+	// Statistics
+	uint32_t GetHits();
+	uint32_t GetMisses();
+	uint32_t GetPrefetches();
+}
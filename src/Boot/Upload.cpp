@@ -0,0 +1,65 @@
+/*
+	[ Funkin ]
+	Copyright Regan "CKDEV" Green 2023-2025
+	
+	- Upload.cpp -
+	VRAM upload queue
+*/
+
+#include "Boot/Upload.h"
+
+#include "Boot/Compress.h"
+
+#include <CKSDK/ExScreen.h>
+#include <CKSDK/GPU.h>
+
+namespace Upload
+{
+	// Staging buffers
+	// Only the last band queued can still be being sent, so bands are decoded into the other buffer
+	static constexpr size_t STAGES = 2;
+
+	static uint32_t stage[STAGES][Compress::BAND_SIZE / 4];
+	static size_t stage_i = 0;
+
+	// Queue state
+	static Fence queued = 0; // Fence of the last transfer queued
+	static Fence passed = 0; // Fence of the last transfer known to be done
+	static Fence staged = 0; // Fence of the last band queued
+
+	// Upload functions
+	KEEP Fence Image(const void *data, uint32_t xy, uint32_t wh, uint32_t bcr)
+	{
+		// Queue transfer
+		CKSDK::GPU::DMAImage(data, xy, wh, bcr);
+		return ++queued;
+	}
+
+	KEEP Fence Band(const void *data, uint32_t compress, uint32_t xy, uint32_t wh, uint32_t bcr)
+	{
+		// Decompress band into the staging buffer the GPU isn't being sent
+		if ((compress & Compress::SIZE) > Compress::BAND_SIZE)
+			CKSDK::ExScreen::Abort("Upload::Band too large");
+
+		uint32_t *stagep = stage[stage_i];
+		stage_i = (stage_i + 1) % STAGES;
+		if (compress & Compress::LZB)
+			Compress::DecompressLZB(data, stagep);
+		else
+			Compress::Decompress(data, stagep);
+
+		// The band before must be sent before this one is queued, freeing its buffer for the next band
+		Wait(staged);
+		staged = Image(stagep, xy, wh, bcr);
+		return staged;
+	}
+
+	KEEP void Wait(Fence fence)
+	{
+		// The queue can only be synced as a whole
+		if ((int32_t)(fence - passed) <= 0)
+			return;
+		CKSDK::GPU::QueueSync();
+		passed = queued;
+	}
+}
@@ -0,0 +1,30 @@
+/*
+	[ Funkin ]
+	Copyright Regan "CKDEV" Green 2023-2025
+	
+	- Upload.h -
+	VRAM upload queue
+*/
+
+#pragma once
+
+#include <CKSDK/CKSDK.h>
+
+namespace Upload
+{
+	// Fences
+	// Every transfer queued gets the next fence, which has passed once it and every transfer before it are done
+	// Fence 0 has always passed
+	typedef uint32_t Fence;
+
+	// Upload functions
+	// Queues a transfer straight from RAM, which must be left alone until its fence has passed
+	Fence Image(const void *data, uint32_t xy, uint32_t wh, uint32_t bcr);
+
+	// Decompresses a band into a staging buffer and queues it, so the compressed data is free once this returns
+	// The band is decoded while the GPU is still being sent the one before
+	Fence Band(const void *data, uint32_t compress, uint32_t xy, uint32_t wh, uint32_t bcr);
+
+	// Waits for the fence to pass, only syncing the queue if it hasn't already
+	void Wait(Fence fence);
+}
@@ -26,23 +26,25 @@ namespace Menu
 		menu_cdp.Read(g_data_cdp.Search("menu.cdp"_h));
 
 		// Read temporary data
-		{
-			CKSDK::CD::File file_temp_mmp = menu_cdp.Search("temp.mmp"_h);
-			std::unique_ptr<char[]> temp_mmp(new char[file_temp_mmp.Size()]);
+		CKSDK::CD::File file_temp_mmp = menu_cdp.Search("temp.mmp"_h);
+		std::unique_ptr<char[]> temp_mmp(new char[file_temp_mmp.Size()]);
 
-			CKSDK::CD::ReadSectors(nullptr, temp_mmp.get(), file_temp_mmp, CKSDK::CD::Mode::Speed);
-			CKSDK::CD::ReadSync();
+		CKSDK::CD::ReadSectors(nullptr, temp_mmp.get(), file_temp_mmp, CKSDK::CD::Mode::Speed);
+		CKSDK::CD::ReadSync();
 
-			void *msh_dma = MMP::Search(temp_mmp.get(), "perm.dma"_h);
-			Character::DMA(msh_dma);
-		}
-		
-		// Read permanent data
+		// Start reading permanent data
 		CKSDK::CD::File file_perm_mmp = menu_cdp.Search("perm.mmp"_h);
 		perm_mmp.reset(new char[file_perm_mmp.Size()]);
 
 		CKSDK::CD::ReadSectors(nullptr, perm_mmp.get(), file_perm_mmp, CKSDK::CD::Mode::Speed);
+
+		// Upload scene textures while it's read, temporary data is freed once they've been sent
+		void *msh_dma = MMP::Search(temp_mmp.get(), "perm.dma"_h);
+		Upload::Fence msh_fence = Character::DMA(msh_dma);
+
 		CKSDK::CD::ReadSync();
+		Upload::Wait(msh_fence);
+		temp_mmp.reset();
 
 		// Get logo mesh
 		/*
@@ -35,8 +35,7 @@ namespace Menu
 	{
 		// Set matrix
 		CKSDK::GPU::Matrix mat = CKSDK::GPU::Matrix::Identity();
-		gte_SetRotMatrix(&mat);
-		gte_ldtz(256);
+		Character::SetTransform(mat, g_screen_z);
 
 		// Draw black background
 		CKSDK::GPU::FillPrim<> &rect = CKSDK::GPU::AllocPacket<CKSDK::GPU::FillPrim<>>(OT::Background);
@@ -90,7 +89,7 @@ namespace Menu
 
 		mat.m[0][0] = logo_scale;
 		mat.m[1][1] = logo_scale;
-		gte_SetRotMatrix(&mat);
+		Character::SetTransform(mat, g_screen_z);
 
 		Character::Draw(-80, -40, OT::Focus - 1, logo_chr, 0, Color::White());
 
@@ -39,6 +39,8 @@ namespace PlayState
 
 		poly.v[2].y = src_poly->v[2].y - trim;
 		poly.v[3].y = src_poly->v[3].y - trim;
+		poly.v[3].pad = src_poly->v[3].pad - trim; // Bounding box bottom
+		header.y1 = poly.v[3].pad;
 
 		// Draw mesh
 		Character::Draw(x, y, OT::UI, &header, Color::White());
@@ -89,8 +91,7 @@ namespace PlayState
 
 		// Initialize matrix
 		CKSDK::GPU::Matrix mat = CKSDK::GPU::Matrix::Identity();
-		gte_SetRotMatrix(&mat);
-		gte_ldtz(256);
+		Character::SetTransform(mat, g_screen_z);
 
 		// Process pieces
 		piece_judgement.Process(mat, dt, trim);
@@ -381,12 +381,66 @@ namespace PlayState
 		}
 	}
 
+	void PlayState::AddNote(NoteInstances &instances, int32_t x, int32_t y, Color color)
+	{
+		// Draw gathered notes if full
+		if (instances.count == c_note_instances)
+			FlushNotes();
+
+		// Gather note
+		instances.positions[instances.count] = CKSDK::GPU::ScreenCoord(x, y);
+		instances.colors[instances.count] = color;
+		instances.count++;
+	}
+
+	void PlayState::AddNoteHold(NoteFrames &note_frame, int32_t x, int32_t start_y, int32_t end_y, Color color)
+	{
+		// Draw gathered notes if full
+		if (note_frame.hold_count == c_note_instances)
+			FlushNotes();
+
+		// Gather hold
+		note_frame.holds[note_frame.hold_count++] = NoteHold{ x, start_y, end_y, color };
+	}
+
+	void PlayState::FlushNotes()
+	{
+		// Draw gathered notes, with each mesh's notes as instances
+		// Notes are linked first, then holds, then hold ends, so a note stays over its hold as it did drawn one at a time
+		for (auto &note_frame : note_frames)
+		{
+			Character::DrawInstances(note_frame.note_msh, note_frame.notes.positions, note_frame.notes.count, OT::UI - 1, note_frame.notes.colors);
+			note_frame.notes.count = 0;
+		}
+
+		for (auto &note_frame : note_frames)
+		{
+			// Each hold stretches the hold mesh to its own length
+			for (size_t i = 0; i < note_frame.hold_count; i++)
+			{
+				const NoteHold &hold = note_frame.holds[i];
+				note_frame.hold_poly.v[2].y = (hold.end_y - hold.start_y);
+				note_frame.hold_poly.v[3].y = (hold.end_y - hold.start_y);
+				note_frame.hold_poly.v[3].pad = (hold.end_y - hold.start_y);
+				note_frame.hold_msh.y1 = (hold.end_y - hold.start_y);
+
+				Character::Draw(hold.x, hold.start_y, OT::UI - 1, &note_frame.hold_msh, hold.color);
+			}
+			note_frame.hold_count = 0;
+		}
+
+		for (auto &note_frame : note_frames)
+		{
+			Character::DrawInstances(note_frame.hold_end_msh, note_frame.hold_ends.positions, note_frame.hold_ends.count, OT::UI - 1, note_frame.hold_ends.colors);
+			note_frame.hold_ends.count = 0;
+		}
+	}
+
 	void PlayState::DrawNotes(Timer::FixedTime dt)
 	{
 		// Initialize matrix
 		CKSDK::GPU::Matrix mat = CKSDK::GPU::Matrix::Identity();
-		gte_SetRotMatrix(&mat);
-		gte_ldtz(256);
+		Character::SetTransform(mat, g_screen_z);
 
 		// Draw strums
 		for (auto &strum : strums)
@@ -452,7 +506,7 @@ namespace PlayState
 					break;
 
 				// Draw note
-				Character::Draw(x, y, OT::UI - 1, note_frame.note_msh, color);
+				AddNote(note_frame.notes, x, y, color);
 			}
 			else
 			{
@@ -489,7 +543,7 @@ namespace PlayState
 				if ((note->type & NoteStatus) != NoteStatusHolding)
 				{
 					// Draw note mesh
-					Character::Draw(x, start_y, OT::UI - 1, note_frame.note_msh, color);
+					AddNote(note_frame.notes, x, start_y, color);
 				}
 				else
 				{
@@ -498,15 +552,15 @@ namespace PlayState
 				}
 
 				// Draw hold
-				note_frame.hold_poly.v[2].y = (end_y - start_y);
-				note_frame.hold_poly.v[3].y = (end_y - start_y);
-
-				Character::Draw(x, start_y, OT::UI - 1, &note_frame.hold_msh, color);
+				AddNoteHold(note_frame, x, start_y, end_y, color);
 
 				// Draw hold end
-				Character::Draw(x, end_y, OT::UI - 1, note_frame.hold_end_msh, color);
+				AddNote(note_frame.hold_ends, x, end_y, color);
 			}
 		}
+
+		// Draw gathered notes
+		FlushNotes();
 	}
 
 	void PlayState::DrawHealth(Timer::FixedTime dt)
@@ -519,9 +573,7 @@ namespace PlayState
 		mat.m[0][0] = health_scale;
 		mat.m[1][1] = health_scale;
 		// mat.m[2][2] = health_scale;
-		gte_SetRotMatrix(&mat);
-
-		gte_ldtz(256);
+		Character::SetTransform(mat, g_screen_z);
 
 		// Clamp health
 		if (health < 0.0)
@@ -537,8 +589,8 @@ namespace PlayState
 			opponent_dead = 1;
 
 		int32_t x = (health - 1.0) * -c_health_w;
-		Character::Draw(x, c_health_y, OT::UI - 3, icon_player_msh, player_dead, Color::White());
-		Character::Draw(x, c_health_y, OT::UI - 3, icon_opponent_msh, opponent_dead, Color::White());
+		icon_player_tmpl.Draw(x, c_health_y, OT::UI - 3, icon_player_msh, player_dead, Color::White());
+		icon_opponent_tmpl.Draw(x, c_health_y, OT::UI - 3, icon_opponent_msh, opponent_dead, Color::White());
 
 		// Draw bar
 		struct BarPacket
@@ -640,6 +692,8 @@ namespace PlayState
 
 			note_frame.hold_poly.v[0].y = 0; // Align top to 0
 			note_frame.hold_poly.v[1].y = 0;
+			note_frame.hold_poly.v[1].pad = 0; // Bounding box top
+			note_frame.hold_msh.y0 = 0;
 		}
 
 		// Initialize song state
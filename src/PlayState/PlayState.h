@@ -147,6 +147,8 @@ namespace PlayState
 
 	static constexpr int32_t c_note_cull = 140;
 
+	static constexpr size_t c_note_instances = 32; // Notes of one mesh gathered before they're drawn
+
 	static constexpr int32_t c_health_y = g_height / 2 - 39;
 	static constexpr int32_t c_health_w = 112;
 	static constexpr int32_t c_health_h = 2;
@@ -172,6 +174,9 @@ namespace PlayState
 			const void *icon_player_msh = nullptr;
 			const void *icon_opponent_msh = nullptr;
 
+			// Health icon packet templates, only rebuilt when an icon changes
+			Character::Template icon_player_tmpl, icon_opponent_tmpl;
+
 			// Time state
 			Timer::FixedTime time = 0;
 
@@ -200,6 +205,19 @@ namespace PlayState
 			int32_t score_str_w;
 
 			// Note frames
+			struct NoteInstances
+			{
+				CKSDK::GPU::ScreenCoord positions[c_note_instances];
+				Color colors[c_note_instances];
+				size_t count = 0;
+			};
+
+			struct NoteHold
+			{
+				int32_t x, start_y, end_y;
+				Color color;
+			};
+
 			struct NoteFrames
 			{
 				// Note frames
@@ -209,6 +227,11 @@ namespace PlayState
 				// Note hold mesh
 				Character::MeshHeader hold_msh;
 				Character::MeshPoly hold_poly;
+
+				// Notes to draw this frame
+				NoteInstances notes, hold_ends;
+				NoteHold holds[c_note_instances];
+				size_t hold_count = 0;
 			} note_frames[NoteDirections];
 
 			// Strums
@@ -264,6 +287,9 @@ namespace PlayState
 			void ProcessKeys(Timer::FixedTime dt);
 			void ProcessNotes(Timer::FixedTime dt);
 
+			void AddNote(NoteInstances &instances, int32_t x, int32_t y, Color color);
+			void AddNoteHold(NoteFrames &note_frame, int32_t x, int32_t start_y, int32_t end_y, Color color);
+			void FlushNotes();
 			void DrawNotes(Timer::FixedTime dt);
 			void DrawHealth(Timer::FixedTime dt);
 			void DrawScore(Timer::FixedTime dt);
@@ -16,6 +16,7 @@
 #include "Boot/MMP.h"
 #include "Boot/Loader.h"
 #include "Boot/Character.h"
+#include "Boot/TexCache.h"
 #include "Boot/Wipe.h"
 #include "Boot/Timer.h"
 
@@ -60,6 +61,9 @@ namespace PlayState
 			const void *stage_back_msh = MMP::Search(perm_mmp.get(), "StageBack.chr"_h);
 			const void *stage_curtains_msh = MMP::Search(perm_mmp.get(), "StageCurtains.chr"_h);
 
+			// Stage packet templates, the stage looks the same every frame
+			Character::Template stage_front_tmpl, stage_back_tmpl[2], stage_curtains_tmpl[2];
+
 		public:
 			// Play state functions
 			Week1()
@@ -69,6 +73,23 @@ namespace PlayState
 				dad.Dance();
 				gf.SetAnimation(0);
 
+				// Cache character frames in spare VRAM
+				// Bf (320,0), Gf (448,0) and Dad (320,256) leave 536-792 above and 384-792 below free up to the stage
+				// MkScene's placement doesn't leave these free, so only the characters' own slots are used with it
+				TexCache::Reset();
+				#ifndef FUNKIN_AUTO_VRAM
+					static const TexCache::Slot bf_slots[] = { { 64, 256, 0, 0 }, { 128, 256, 0, 0 }, { 256, 0, 0, 0 }, { 320, 0, 0, 0 } };
+					static const TexCache::Slot dad_slots[] = { { 192, 0, 0, 0 }, { 256, 0, 0, 0 } };
+					static const TexCache::Slot gf_slots[] = { { 192, 256, 0, 0 }, { 256, 0, 0, 0 } };
+					TexCache::AddPool(MMP::Search(perm_mmp.get(), "Bf.chr"_h), bf_slots, std::size(bf_slots));
+					TexCache::AddPool(MMP::Search(perm_mmp.get(), "Dad.chr"_h), dad_slots, std::size(dad_slots));
+					TexCache::AddPool(MMP::Search(perm_mmp.get(), "Gf.chr"_h), gf_slots, std::size(gf_slots));
+				#else
+					TexCache::AddPool(MMP::Search(perm_mmp.get(), "Bf.chr"_h), nullptr, 0);
+					TexCache::AddPool(MMP::Search(perm_mmp.get(), "Dad.chr"_h), nullptr, 0);
+					TexCache::AddPool(MMP::Search(perm_mmp.get(), "Gf.chr"_h), nullptr, 0);
+				#endif
+
 				// Get assets
 				note_msh = MMP::Search(perm_mmp.get(), "Note.chr"_h);
 
@@ -81,7 +102,8 @@ namespace PlayState
 
 			~Week1()
 			{
-
+				// Drop texture cache pools
+				TexCache::Reset();
 			}
 
 			void BeatHit() override
@@ -160,8 +182,7 @@ namespace PlayState
 
 				// Initialize matrix
 				CKSDK::GPU::Matrix mat = CKSDK::GPU::Matrix::Identity();
-				gte_SetRotMatrix(&mat);
-				gte_ldtz(cz);
+				Character::SetTransform(mat, cz);
 
 				// Draw black background
 				CKSDK::GPU::FillPrim<> &rect = CKSDK::GPU::AllocPacket<CKSDK::GPU::FillPrim<>>(OT::Background);
@@ -170,20 +191,20 @@ namespace PlayState
 				rect.wh = CKSDK::GPU::ScreenDim(g_width, g_height);
 
 				// Draw stage
-				Character::Draw(0 - cx, 64 - cy, OT::Background - 1, stage_front_msh, 0, Color::White());
+				stage_front_tmpl.Draw(0 - cx, 64 - cy, OT::Background - 1, stage_front_msh, 0, Color::White());
 
 				{
 					int32_t cx = camera.GetX(0.9);
 					int32_t cy = camera.GetY(0.9);
-					Character::Draw(-150 - cx, -80 - cy, OT::Background - 1, stage_back_msh, 0, Color::White());
-					Character::Draw(0 - cx, -110 - cy, OT::Background - 1, stage_back_msh, 1, Color::White());
+					stage_back_tmpl[0].Draw(-150 - cx, -80 - cy, OT::Background - 1, stage_back_msh, 0, Color::White());
+					stage_back_tmpl[1].Draw(0 - cx, -110 - cy, OT::Background - 1, stage_back_msh, 1, Color::White());
 				}
 
 				{
 					int32_t cx = camera.GetX(1.5);
 					int32_t cy = camera.GetY(1.5);
-					Character::Draw(-250 - cx, -150 - cy, OT::Focus - 1, stage_curtains_msh, 0, Color::White());
-					Character::Draw(220 - cx, -150 - cy, OT::Focus - 1, stage_curtains_msh, 1, Color::White());
+					stage_curtains_tmpl[0].Draw(-250 - cx, -150 - cy, OT::Focus - 1, stage_curtains_msh, 0, Color::White());
+					stage_curtains_tmpl[1].Draw(220 - cx, -150 - cy, OT::Focus - 1, stage_curtains_msh, 1, Color::White());
 				}
 
 				// Draw boyfriend character
@@ -210,23 +231,25 @@ namespace Week1
 		week1_cdp.Read(g_data_cdp.Search("week1.cdp"_h));
 
 		// Read temporary data
-		{
-			CKSDK::CD::File file_temp_mmp = week1_cdp.Search("temp.mmp"_h);
-			std::unique_ptr<char[]> temp_mmp(new char[file_temp_mmp.Size()]);
-			
-			CKSDK::CD::ReadSectors(nullptr, temp_mmp.get(), file_temp_mmp, CKSDK::CD::Mode::Speed);
-			CKSDK::CD::ReadSync();
-
-			void *msh_dma = MMP::Search(temp_mmp.get(), "perm.dma"_h);
-			Character::DMA(msh_dma);
-		}
-		
-		// Read permanent data
+		CKSDK::CD::File file_temp_mmp = week1_cdp.Search("temp.mmp"_h);
+		std::unique_ptr<char[]> temp_mmp(new char[file_temp_mmp.Size()]);
+
+		CKSDK::CD::ReadSectors(nullptr, temp_mmp.get(), file_temp_mmp, CKSDK::CD::Mode::Speed);
+		CKSDK::CD::ReadSync();
+
+		// Start reading permanent data
 		CKSDK::CD::File file_perm_mmp = week1_cdp.Search("perm.mmp"_h);
 		perm_mmp.reset(new char[file_perm_mmp.Size()]);
 
 		CKSDK::CD::ReadSectors(nullptr, perm_mmp.get(), file_perm_mmp, CKSDK::CD::Mode::Speed);
+
+		// Upload scene textures while it's read, temporary data is freed once they've been sent
+		void *msh_dma = MMP::Search(temp_mmp.get(), "perm.dma"_h);
+		Upload::Fence msh_fence = Character::DMA(msh_dma);
+
 		CKSDK::CD::ReadSync();
+		Upload::Wait(msh_fence);
+		temp_mmp.reset();
 
 		// Init play state
 		std::unique_ptr<PlayState::Week1> play_state(new PlayState::Week1());
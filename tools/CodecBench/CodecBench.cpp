@@ -0,0 +1,371 @@
+/*
+	[ CodecBench ]
+	Copyright Regan "CKDEV" Green 2023-2025
+	
+	- CodecBench.cpp -
+	DMA codec benchmark
+*/
+
+#include <FunkinXml.h>
+
+#include <iomanip>
+#include <random>
+
+// Codecs compared
+static const Codec codecs[] = { Codec::Comper, Codec::LZB };
+static const char *codec_names[] = { "Comper", "LZB" };
+static constexpr size_t CODECS = sizeof(codecs) / sizeof(codecs[0]);
+
+// Benchmark totals
+struct Totals
+{
+	size_t dmas = 0, raw = 0;
+	size_t size[CODECS] = {};
+	double cycles[CODECS] = {};
+	double compress_ms[CODECS] = {}, decompress_ms[CODECS] = {}; // Host time, compressing includes its round trip check
+	size_t picked[3] = {}; // Codecs compress="auto" picks for bands uploaded once, indexed by Codec
+
+	void Add(const Totals &o)
+	{
+		dmas += o.dmas;
+		raw += o.raw;
+		for (size_t i = 0; i < CODECS; i++)
+		{
+			size[i] += o.size[i];
+			cycles[i] += o.cycles[i];
+			compress_ms[i] += o.compress_ms[i];
+			decompress_ms[i] += o.decompress_ms[i];
+		}
+		for (size_t i = 0; i < 3; i++)
+			picked[i] += o.picked[i];
+	}
+
+	void Report(std::string name) const
+	{
+		auto rate = [&](double ms) { return (ms > 0.0) ? ((raw / 1048576.0) / (ms / 1000.0)) : 0.0; };
+
+		std::cout << name << ": " << dmas << " DMAs, " << raw << " bytes" << std::endl;
+		for (size_t i = 0; i < CODECS; i++)
+		{
+			std::cout << "  " << std::left << std::setw(7) << codec_names[i] << std::right
+				<< std::setw(9) << size[i] << " bytes, " << std::fixed << std::setprecision(1)
+				<< std::setw(5) << (raw ? (100.0 * size[i] / raw) : 0.0) << "%, "
+				<< std::setprecision(2) << (raw ? (cycles[i] / raw) : 0.0) << " cycles per byte, host "
+				<< std::setprecision(1) << rate(compress_ms[i]) << " MiB/s compress, " << rate(decompress_ms[i]) << " MiB/s decompress" << std::endl;
+		}
+		std::cout << "  auto    " << picked[size_t(Codec::None)] << " raw, " << picked[size_t(Codec::Comper)] << " Comper, " << picked[size_t(Codec::LZB)] << " LZB" << std::endl;
+	}
+};
+
+// Benchmarks one DMA, compressed as bands like the compiler does
+static Totals Bench(const DMA &dma, double budget)
+{
+	Totals totals;
+	totals.dmas = 1;
+	totals.raw = dma.size;
+
+	std::vector<DMA> bands = dma.Bands();
+	for (size_t i = 0; i < CODECS; i++)
+	{
+		for (auto &j : bands)
+		{
+			DMA compressed = j.Clone();
+
+			Clock::time_point start = Clock::now();
+			compressed.Compress(codecs[i]);
+			Clock::time_point compressed_at = Clock::now();
+			compressed.Decompress();
+			Clock::time_point end = Clock::now();
+
+			totals.size[i] += compressed.size;
+			totals.cycles[i] += compressed.DecodeCycles();
+			totals.compress_ms[i] += Millis(compressed_at - start);
+			totals.decompress_ms[i] += Millis(end - compressed_at);
+		}
+	}
+
+	for (auto &i : bands)
+	{
+		DMA picked = i.Clone();
+		picked.Compress(budget, 1);
+		totals.picked[size_t(picked.GetCodec())]++;
+	}
+	return totals;
+}
+
+// Fuzzing
+// Random buffers of runs, repeats and few-colour noise, like 4bpp images, are round tripped through each codec,
+// then their streams are corrupted, which the reference decoders must reject or decode without leaving their buffers
+static void Fuzz(size_t count, unsigned jobs)
+{
+	std::atomic<size_t> rejected(0), corrupted(0);
+
+	Worker::Run(count, jobs, [&](size_t i)
+	{
+		std::mt19937 rng((unsigned)i);
+		auto random = [&](size_t n) { return size_t(rng() % n); };
+
+		// Make buffer
+		size_t size = random(STREAM_BAND_SIZE / 4) * 4;
+		std::vector<uint8_t> buffer;
+		buffer.reserve(size);
+
+		uint8_t colours[4];
+		for (auto &j : colours)
+			j = uint8_t(rng());
+
+		while (buffer.size() < size)
+		{
+			size_t length = std::min(1 + random(64), size - buffer.size());
+			switch (random(3))
+			{
+				case 0:
+					buffer.insert(buffer.end(), length, colours[random(4)]);
+					break;
+				case 1:
+					if (!buffer.empty())
+					{
+						size_t from = random(buffer.size());
+						for (size_t j = 0; j < length; j++)
+							buffer.push_back(buffer[from + j]);
+						break;
+					}
+					// Fallthrough
+				case 2:
+					for (size_t j = 0; j < length; j++)
+						buffer.push_back(colours[random(4)]);
+					break;
+			}
+		}
+
+		DMA dma;
+		dma.size = uint32_t(size);
+		dma.data.reset(new uint8_t[size]);
+		memcpy(dma.data.get(), buffer.data(), size);
+
+		for (auto codec : codecs)
+		{
+			// Compress checks the round trip itself
+			DMA compressed = dma.Clone();
+			compressed.Compress(codec);
+
+			for (unsigned j = 0; j < 8 && compressed.size != 0; j++)
+			{
+				DMA corrupt = compressed.Clone();
+				size_t flips = 1 + random(4);
+				for (size_t k = 0; k < flips; k++)
+					corrupt.data[random(corrupt.size)] ^= uint8_t(1 + random(255));
+
+				corrupted++;
+				try
+				{
+					corrupt.Decompress();
+				}
+				catch (const RuntimeError &)
+				{
+					rejected++;
+				}
+			}
+		}
+	});
+
+	std::cout << "Fuzzed " << count << " buffers, " << rejected << " of " << corrupted << " corrupted streams rejected" << std::endl;
+}
+
+// Pixel kernels
+// Each kernel is checked against its scalar version over every count up to a few vectors and every misalignment,
+// with guard bytes after the output, then both are timed over a large buffer
+static void Kernels(size_t pixels)
+{
+	std::mt19937 rng(0);
+
+	// Alpha values around the threshold are picked more often than the rest
+	auto random_rgba = [&]()
+	{
+		static const uint8_t alphas[] = { 0x00, 0x3F, 0x40, 0x41, 0xBF, 0xC0, 0xC1, 0xFF };
+		RGBA c;
+		uint32_t r = rng();
+		c.r = uint8_t(r);
+		c.g = uint8_t(r >> 8);
+		c.b = uint8_t(r >> 16);
+		c.a = (r & 0x1000000) ? alphas[(r >> 28) & 7] : uint8_t(rng());
+		return c;
+	};
+
+	static constexpr size_t MAX_COUNT = 67, MAX_OFFSET = 16, GUARD = 16;
+	size_t checked = 0;
+	for (size_t count = 0; count <= MAX_COUNT; count++)
+	{
+		for (size_t offset = 0; offset < MAX_OFFSET; offset++)
+		{
+			// AlphaThreshold, in place
+			std::vector<RGBA> rgba(offset + count);
+			for (auto &i : rgba)
+				i = random_rgba();
+			std::vector<RGBA> rgba_kernel = rgba, rgba_scalar = rgba;
+			Kernel::AlphaThreshold(rgba_kernel.data() + offset, count);
+			Kernel::AlphaThresholdScalar(rgba_scalar.data() + offset, count);
+			if (memcmp(rgba_kernel.data(), rgba_scalar.data(), rgba.size() * sizeof(RGBA)) != 0)
+				throw RuntimeError("AlphaThreshold differs from scalar at count " + std::to_string(count) + " offset " + std::to_string(offset));
+
+			// PackNibbles
+			std::vector<uint8_t> indices(offset + count);
+			for (auto &i : indices)
+				i = uint8_t(rng() & 0xF);
+			std::vector<uint8_t> packed_kernel(offset + (count + 1) / 2 + GUARD, 0xA5), packed_scalar(offset + (count + 1) / 2 + GUARD, 0xA5);
+			Kernel::PackNibbles(packed_kernel.data() + offset, indices.data() + offset, count);
+			Kernel::PackNibblesScalar(packed_scalar.data() + offset, indices.data() + offset, count);
+			if (packed_kernel != packed_scalar)
+				throw RuntimeError("PackNibbles differs from scalar at count " + std::to_string(count) + " offset " + std::to_string(offset));
+
+			checked++;
+		}
+	}
+	std::cout << "Kernels (" << Kernel::Name() << ") match scalar over " << checked << " counts and offsets" << std::endl;
+
+	// Time each kernel against its scalar version, best of a few runs
+	std::vector<RGBA> rgba(pixels), rgba_work(pixels);
+	for (auto &i : rgba)
+		i = random_rgba();
+	std::vector<uint8_t> indices(pixels), packed((pixels + 1) / 2);
+	for (auto &i : indices)
+		i = uint8_t(rng() & 0xF);
+
+	auto time = [&](const char *name, size_t bytes, auto &&kernel, auto &&scalar)
+	{
+		double best[2] = { 1e30, 1e30 };
+		for (int run = 0; run < 5; run++)
+		{
+			for (int i = 0; i < 2; i++)
+			{
+				rgba_work = rgba;
+				Clock::time_point start = Clock::now();
+				if (i == 0)
+					kernel();
+				else
+					scalar();
+				best[i] = std::min(best[i], Millis(Clock::now() - start));
+			}
+		}
+		auto rate = [&](double ms) { return (bytes / 1048576.0) / (ms / 1000.0); };
+		std::cout << "  " << std::left << std::setw(15) << name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(8) << rate(best[0]) << " MiB/s, scalar " << std::setw(8) << rate(best[1]) << " MiB/s, "
+			<< std::setprecision(2) << (best[1] / best[0]) << "x" << std::endl;
+	};
+
+	time("AlphaThreshold", pixels * sizeof(RGBA),
+		[&]() { Kernel::AlphaThreshold(rgba_work.data(), pixels); },
+		[&]() { Kernel::AlphaThresholdScalar(rgba_work.data(), pixels); });
+	time("PackNibbles", pixels,
+		[&]() { Kernel::PackNibbles(packed.data(), indices.data(), pixels); },
+		[&]() { Kernel::PackNibblesScalar(packed.data(), indices.data(), pixels); });
+}
+
+// Entry point
+int main(int argc, char *argv[])
+{
+	try
+	{
+		// Read options
+		Options options;
+		options.uncompressed = true;
+		size_t fuzz = 0;
+		size_t kernels = 0;
+
+		int argi = 1;
+		for (; argi < argc && argv[argi][0] == '-'; argi++)
+		{
+			std::string option(argv[argi]);
+			if (option == "-j" && (argi + 1) < argc)
+				options.jobs = std::stoul(argv[++argi]);
+			else if (option.size() > 2 && option.compare(0, 2, "-j") == 0)
+				options.jobs = std::stoul(option.substr(2));
+			else if (option == "-c" && (argi + 1) < argc)
+				options.cache_dir = argv[++argi];
+			else if (option == "-z" && (argi + 1) < argc)
+				options.compress_budget = std::stod(argv[++argi]);
+			else if (option == "-f" && (argi + 1) < argc)
+				fuzz = std::stoul(argv[++argi]);
+			else if (option == "-k" && (argi + 1) < argc)
+				kernels = std::stoul(argv[++argi]);
+			else
+				throw RuntimeError("Unknown option " + option);
+		}
+
+		if ((fuzz == 0 && kernels == 0 && (argc - argi) < 2) || ((argc - argi) & 1))
+		{
+			std::cout << "usage: CodecBench [-j jobs] [-c cachedir] [-z budget] [-f fuzzcount] [-k kernelpixels] [chr chr.xml | msh msh.xml | spr spr.xml]..." << std::endl;
+			return 0;
+		}
+
+		if (kernels != 0)
+			Kernels(kernels);
+		if (fuzz != 0)
+			Fuzz(fuzz, options.jobs);
+		if (argi == argc)
+			return 0;
+
+		// Scenes share xmls, so each is only benchmarked once
+		std::vector<std::pair<std::string, std::string>> entries;
+		std::set<std::string> seen;
+		for (; argi < argc; argi += 2)
+			if (seen.insert(argv[argi + 1]).second)
+				entries.emplace_back(argv[argi], argv[argi + 1]);
+
+		// Sprite sheets are shared between xmls, as in MkScene
+		SheetCache sheets;
+		options.sheets = &sheets;
+		for (auto &i : entries)
+			sheets.Expect(GetSheetName(i.second));
+
+		// Compile every xml uncompressed and compress its DMAs with each codec
+		Totals all;
+		for (auto &entry : entries)
+		{
+			const std::string &kind = entry.first;
+			const std::string &xml = entry.second;
+
+			std::vector<const DMA*> dmas;
+			std::unique_ptr<CharacterXml<Mesh>> msh;
+			std::unique_ptr<CharacterXml<Sprites>> spr;
+			if (kind == "chr" || kind == "msh")
+			{
+				msh.reset(new CharacterXml<Mesh>(xml, nullptr, nullptr, nullptr, options));
+				for (auto &i : msh->frames)
+					for (auto &j : i.dmas)
+						dmas.push_back(&j);
+			}
+			else if (kind == "spr")
+			{
+				spr.reset(new CharacterXml<Sprites>(xml, nullptr, nullptr, nullptr, options));
+				for (auto &i : spr->frames)
+					for (auto &j : i.dmas)
+						dmas.push_back(&j);
+			}
+			else
+			{
+				throw RuntimeError("Bad benchmark entry " + kind);
+			}
+
+			std::vector<Totals> results(dmas.size());
+			Worker::Run(dmas.size(), options.jobs, [&](size_t i)
+			{
+				results[i] = Bench(*dmas[i], options.compress_budget);
+			});
+
+			Totals totals;
+			for (auto &i : results)
+				totals.Add(i);
+			totals.Report(xml);
+			all.Add(totals);
+		}
+
+		all.Report("Total");
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,307 @@
+/*
+	[ MkScene ]
+	Copyright Regan "CKDEV" Green 2023-2025
+
+	- MkScene.cpp -
+	Scene batch generator
+*/
+
+#include <FunkinXml.h>
+
+#include <algorithm>
+
+// Permanent dma
+// Matches MkDma, which dedupes the padded DMAs of every .dma file in order
+struct PermDma
+{
+	const DMA *dma;
+	uint32_t size;
+	Hash::Hash64 hash;
+
+	uint8_t At(uint32_t i) const
+	{ return (i < dma->size) ? dma->data[i] : 0; }
+
+	bool operator==(const PermDma &o) const
+	{
+		if (size != o.size || dma->bcr != o.dma->bcr || dma->compress != o.dma->compress ||
+			dma->x != o.dma->x || dma->y != o.dma->y || dma->w != o.dma->w || dma->h != o.dma->h)
+			return false;
+		for (uint32_t i = 0; i < size; i++)
+			if (At(i) != o.At(i))
+				return false;
+		return true;
+	}
+};
+
+static void WritePermDma(const char *name, const std::vector<const std::vector<DMA>*> &lists)
+{
+	// Collect unique DMAs
+	std::vector<PermDma> dmas;
+	std::unordered_multimap<Hash::Hash64, size_t> dmas_find;
+	size_t total = 0;
+
+	for (auto &i : lists)
+	{
+		for (auto &j : *i)
+		{
+			PermDma dma;
+			dma.dma = &j;
+			dma.size = j.size;
+			if (dma.size & 0xF)
+				dma.size += 0x10 - (dma.size & 0xF);
+			dma.hash = Hash::FromBuffer64(j.data.get(), j.size);
+			total++;
+
+			bool found = false;
+			auto range = dmas_find.equal_range(dma.hash);
+			for (auto k = range.first; k != range.second; k++)
+			{
+				if (dmas[k->second] == dma)
+				{
+					found = true;
+					break;
+				}
+			}
+			if (found)
+				continue;
+
+			dmas_find.emplace(dma.hash, dmas.size());
+			dmas.push_back(dma);
+		}
+	}
+
+	// Write out dma
+	std::ofstream stream(name, std::ios::binary);
+	if (!stream)
+		throw RuntimeError(std::string("Failed to open") + name);
+
+	Write32(stream, dmas.size());
+	uint32_t poff = 4 + (4 * 6) * dmas.size();
+	for (auto &i : dmas)
+	{
+		Write32(stream, poff);
+		poff += i.size;
+		Write32(stream, i.size);
+		Write32(stream, i.dma->bcr);
+		Write32(stream, i.dma->compress);
+		Write16(stream, i.dma->x); Write16(stream, i.dma->y);
+		Write16(stream, i.dma->w); Write16(stream, i.dma->h);
+	}
+	for (auto &i : dmas)
+	{
+		for (uint32_t j = 0; j < i.size; j++)
+			stream.put(char(i.At(j)));
+	}
+
+	std::cout << name << ": " << dmas.size() << " of " << total << " DMAs unique" << std::endl;
+}
+
+// Scene entry
+struct Entry
+{
+	std::string kind;
+	const char *xml, *out, *dma;
+	Placement placement;
+};
+
+// VRAM placement
+// A character's frames are uploaded one at a time, so they share one slot and CLUT
+// Mesh and sprite frames are all resident at once, so each gets its own slot
+static void PlaceScene(std::vector<Entry> &entries)
+{
+	struct Request
+	{
+		Placement::Frame *frame;
+		std::vector<Placement::Frame*> shares;
+		int w, h, fw, fh;
+		bool highbpp;
+		std::string name;
+	};
+	std::vector<Request> textures, cluts;
+
+	for (auto &i : entries)
+	{
+		XmlLayout layout = MeasureXml(i.xml);
+		i.placement.frames.resize(layout.frames.size());
+
+		// A tile atlas' size isn't known until its frames are compiled
+		if (layout.tiled)
+			throw RuntimeError(std::string(i.xml) + " is tiled, its tx/ty must be placed by hand");
+
+		std::vector<Placement::Frame*> frames;
+		for (size_t j = 0; j < layout.frames.size(); j++)
+			if (layout.frames[j].w != 0 && layout.frames[j].h != 0)
+				frames.push_back(&i.placement.frames[j]);
+		if (frames.empty())
+			continue;
+
+		if (i.kind == "chr")
+		{
+			// One slot big enough for every frame
+			Request texture = { frames[0], frames, 0, 0, 0, 0, layout.highbpp, i.xml };
+			for (auto &j : layout.frames)
+			{
+				texture.w = std::max(texture.w, j.w);
+				texture.h = std::max(texture.h, j.h);
+			}
+			textures.push_back(texture);
+		}
+		else
+		{
+			for (size_t j = 0; j < layout.frames.size(); j++)
+			{
+				if (layout.frames[j].w == 0 || layout.frames[j].h == 0)
+					continue;
+				Placement::Frame *frame = &i.placement.frames[j];
+				textures.push_back(Request{ frame, { frame }, layout.frames[j].w, layout.frames[j].h, 0, 0, layout.highbpp, i.xml });
+			}
+		}
+
+		if (i.kind == "chr" || layout.singleclut)
+		{
+			cluts.push_back(Request{ frames[0], frames, 0, 0, 0, 0, layout.highbpp, i.xml });
+		}
+		else
+		{
+			for (auto &j : frames)
+				cluts.push_back(Request{ j, { j }, 0, 0, 0, 0, layout.highbpp, i.xml });
+		}
+	}
+
+	// Tallest first packs best on a skyline
+	for (auto &i : textures)
+		VramAllocator::Footprint(i.w, i.h, i.highbpp, i.fw, i.fh);
+	std::stable_sort(textures.begin(), textures.end(), [](const Request &a, const Request &b) { return a.fh != b.fh ? a.fh > b.fh : a.fw > b.fw; });
+	std::stable_sort(cluts.begin(), cluts.end(), [](const Request &a, const Request &b) { return a.highbpp > b.highbpp; });
+
+	VramAllocator vram(320, 480);
+	for (auto &i : textures)
+	{
+		int tx, ty;
+		if (!vram.Texture(i.w, i.h, i.highbpp, tx, ty))
+			throw RuntimeError("Out of VRAM placing a " + std::to_string(i.w) + "x" + std::to_string(i.h) + " frame of " + i.name);
+		for (auto &j : i.shares)
+		{
+			j->tx = tx;
+			j->ty = ty;
+		}
+	}
+	for (auto &i : cluts)
+	{
+		int cx, cy;
+		if (!vram.Clut(i.highbpp, cx, cy))
+			throw RuntimeError("Out of VRAM placing a CLUT of " + i.name);
+		for (auto &j : i.shares)
+		{
+			j->cx = cx;
+			j->cy = cy;
+		}
+	}
+
+	vram.Report(std::cout);
+}
+
+// Entry point
+int main(int argc, char *argv[])
+{
+	try
+	{
+		// Read options
+		Options options;
+		bool place = false;
+
+		int argi = 1;
+		for (; argi < argc && argv[argi][0] == '-'; argi++)
+		{
+			std::string option(argv[argi]);
+			if (option == "-j" && (argi + 1) < argc)
+				options.jobs = std::stoul(argv[++argi]);
+			else if (option.size() > 2 && option.compare(0, 2, "-j") == 0)
+				options.jobs = std::stoul(option.substr(2));
+			else if (option == "-c" && (argi + 1) < argc)
+				options.cache_dir = argv[++argi];
+			else if (option == "-z" && (argi + 1) < argc)
+				options.compress_budget = std::stod(argv[++argi]);
+			else if (option == "-a")
+				place = true;
+			else
+				throw RuntimeError("Unknown option " + option);
+		}
+
+		if ((argc - argi) < 1)
+		{
+			std::cout << "usage: MkScene [-j jobs] [-c cachedir] [-z budget] [-a] perm.dma [chr chr.xml chr.chr | msh msh.xml msh.chr msh.dma | spr spr.xml spr.spr spr.dma]..." << std::endl;
+			return 0;
+		}
+		const char *perm_name = argv[argi++];
+
+		// Sprite sheets are shared by every xml in the scene
+		// Each sheet's users are counted up front so it can be freed after its last one
+		SheetCache sheets;
+		options.sheets = &sheets;
+
+		// Read scene entries
+		std::vector<Entry> entries;
+		while (argi < argc)
+		{
+			Entry entry;
+			entry.kind = argv[argi++];
+
+			int args = (entry.kind == "chr") ? 2 : 3;
+			if (entry.kind != "chr" && entry.kind != "msh" && entry.kind != "spr")
+				throw RuntimeError("Bad scene entry " + entry.kind);
+			if ((argc - argi) < args)
+				throw RuntimeError(entry.kind + " needs " + ((args == 2) ? "xml out" : "xml out dma"));
+
+			entry.xml = argv[argi];
+			entry.out = argv[argi + 1];
+			entry.dma = (args == 3) ? argv[argi + 2] : nullptr;
+			argi += args;
+
+			sheets.Expect(GetSheetName(entry.xml));
+			entries.push_back(std::move(entry));
+		}
+
+		// Place the scene in VRAM
+		if (place)
+			PlaceScene(entries);
+
+		// Compile scene
+		// The compiled frames are kept so perm.dma can be built without reading the .dma files back
+		std::vector<std::unique_ptr<CharacterXml<Mesh>>> mshs;
+		std::vector<std::unique_ptr<CharacterXml<Sprites>>> sprs;
+		std::vector<const std::vector<DMA>*> perm;
+
+		for (auto &i : entries)
+		{
+			const Placement *placement = place ? &i.placement : nullptr;
+			if (i.kind == "chr")
+			{
+				CharacterXml<Mesh> chr_xml(i.xml, i.out, nullptr, nullptr, options, placement);
+			}
+			else if (i.kind == "msh")
+			{
+				mshs.emplace_back(new CharacterXml<Mesh>(i.xml, nullptr, i.out, i.dma, options, placement));
+				for (auto &j : mshs.back()->frames)
+					perm.push_back(&j.dmas);
+			}
+			else
+			{
+				sprs.emplace_back(new CharacterXml<Sprites>(i.xml, nullptr, i.out, i.dma, options, placement));
+				for (auto &j : sprs.back()->frames)
+					perm.push_back(&j.dmas);
+			}
+		}
+
+		// Write permanent dma
+		WritePermDma(perm_name, perm);
+
+		std::cout << perm_name << ": sheets " << sheets.misses << " decoded, " << sheets.hits << " shared, peak RSS " << (PeakRSS() >> 20) << " MiB" << std::endl;
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
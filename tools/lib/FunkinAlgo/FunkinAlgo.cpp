@@ -10,8 +10,29 @@
 
 #include <libimagequant.h>
 #include <comper.h>
+#include <lzb.h>
 
 #include <cmath>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <filesystem>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FUNKIN_SSE2
+#include <emmintrin.h>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -21,6 +42,253 @@
 #include "stb_image_resize.h"
 #undef STB_IMAGE_RESIZE_IMPLEMENTATION
 
+// Memory
+size_t PeakRSS()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return size_t(usage.ru_maxrss);
+#else
+	return size_t(usage.ru_maxrss) * 1024; // Linux reports kilobytes
+#endif
+#endif
+}
+
+// Worker pool
+unsigned Worker::Jobs(unsigned jobs)
+{
+	if (jobs == 0)
+		jobs = std::thread::hardware_concurrency();
+	if (jobs == 0)
+		jobs = 1;
+	return jobs;
+}
+
+void Worker::Run(size_t count, unsigned jobs, const std::function<void(size_t)> &func)
+{
+	// Don't spawn more threads than there is work
+	jobs = Jobs(jobs);
+	if (jobs > count)
+		jobs = unsigned(count);
+
+	if (jobs <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	// Pull indices until we run out or a job fails
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+
+	auto worker = [&]()
+	{
+		while (!failed)
+		{
+			size_t i = next++;
+			if (i >= count)
+				break;
+
+			try
+			{
+				func(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!failed)
+					error = std::current_exception();
+				failed = true;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < jobs; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &i : threads)
+		i.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+// SHA-256
+static const uint32_t SHA256_K[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+static inline uint32_t Rotr(uint32_t x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+Hash::Sha256::Sha256()
+{
+	static const uint32_t iv[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+	memcpy(state, iv, sizeof(state));
+}
+
+void Hash::Sha256::Compress(const uint8_t *p)
+{
+	uint32_t w[64];
+	for (int i = 0; i < 16; i++)
+		w[i] = (uint32_t(p[i * 4 + 0]) << 24) | (uint32_t(p[i * 4 + 1]) << 16) | (uint32_t(p[i * 4 + 2]) << 8) | uint32_t(p[i * 4 + 3]);
+	for (int i = 16; i < 64; i++)
+	{
+		uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+	for (int i = 0; i < 64; i++)
+	{
+		uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+		uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void Hash::Sha256::Update(const void *data, size_t size)
+{
+	const uint8_t *p = (const uint8_t*)data;
+	length += size;
+
+	// Top up a partial block first, then compress whole blocks straight from the input
+	if (block_size != 0)
+	{
+		size_t take = std::min(size, sizeof(block) - block_size);
+		memcpy(block + block_size, p, take);
+		block_size += take;
+		p += take;
+		size -= take;
+		if (block_size < sizeof(block))
+			return;
+		Compress(block);
+		block_size = 0;
+	}
+	for (; size >= sizeof(block); p += sizeof(block), size -= sizeof(block))
+		Compress(p);
+	memcpy(block, p, size);
+	block_size = size;
+}
+
+Hash::Sha256::Digest Hash::Sha256::Final()
+{
+	uint64_t bits = length * 8;
+	uint8_t pad[72] = { 0x80 };
+	size_t pad_size = ((block_size < 56) ? 56 : 120) - block_size;
+	for (int i = 0; i < 8; i++)
+		pad[pad_size + i] = uint8_t(bits >> (56 - i * 8));
+	Update(pad, pad_size + 8);
+
+	Digest digest;
+	for (int i = 0; i < 8; i++)
+	{
+		digest[i * 4 + 0] = uint8_t(state[i] >> 24);
+		digest[i * 4 + 1] = uint8_t(state[i] >> 16);
+		digest[i * 4 + 2] = uint8_t(state[i] >> 8);
+		digest[i * 4 + 3] = uint8_t(state[i] >> 0);
+	}
+	return digest;
+}
+
+// Pixel kernels
+const char *Kernel::Name()
+{
+#if defined(FUNKIN_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+void Kernel::AlphaThresholdScalar(RGBA *p, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		p[i].a = (p[i].a > 0x40) ? 0xFF : 0x00;
+}
+
+void Kernel::PackNibblesScalar(uint8_t *out, const uint8_t *in, size_t count)
+{
+	for (size_t i = 0; i < count; i += 2)
+	{
+		uint8_t x = in[i];
+		if ((i + 1) < count)
+			x |= in[i + 1] << 4;
+		*out++ = x;
+	}
+}
+
+#if defined(FUNKIN_SSE2)
+void Kernel::AlphaThreshold(RGBA *p, size_t count)
+{
+	// 4 pixels at a time, alpha is the top byte of each little endian pixel
+	const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i threshold = _mm_set1_epi32(0x40);
+
+	size_t i = 0;
+	for (; (i + 4) <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&p[i]);
+		__m128i opaque = _mm_cmpgt_epi32(_mm_srli_epi32(v, 24), threshold);
+		v = _mm_or_si128(_mm_and_si128(v, rgb_mask), _mm_andnot_si128(rgb_mask, opaque));
+		_mm_storeu_si128((__m128i*)&p[i], v);
+	}
+	AlphaThresholdScalar(p + i, count - i);
+}
+
+void Kernel::PackNibbles(uint8_t *out, const uint8_t *in, size_t count)
+{
+	// 16 indices into 8 bytes at a time
+	const __m128i lo_mask = _mm_set1_epi16(0x00FF);
+
+	size_t i = 0;
+	for (; (i + 16) <= count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&in[i]);
+		__m128i even = _mm_and_si128(v, lo_mask);
+		__m128i odd = _mm_srli_epi16(v, 8);
+		__m128i x = _mm_and_si128(_mm_or_si128(even, _mm_slli_epi16(odd, 4)), lo_mask);
+		_mm_storel_epi64((__m128i*)&out[i >> 1], _mm_packus_epi16(x, x));
+	}
+	PackNibblesScalar(out + (i >> 1), in + i, count - i);
+}
+#else
+void Kernel::AlphaThreshold(RGBA *p, size_t count)
+{
+	AlphaThresholdScalar(p, count);
+}
+
+void Kernel::PackNibbles(uint8_t *out, const uint8_t *in, size_t count)
+{
+	PackNibblesScalar(out, in, count);
+}
+#endif
+
 // Quantization
 void Quant::Generate(const Image &in, const RGBA *fixed, int in_l, int in_t, int in_r, int in_b, bool highbpp, bool dither)
 {
@@ -31,11 +299,10 @@ void Quant::Generate(const Image &in, const RGBA *fixed, int in_l, int in_t, int
 		throw RuntimeError("No rect given");
 	image.reset(new uint8_t[w * h]{});
 
-	// Crop image
-	std::unique_ptr<RGBA[]> crop(new RGBA[w * h]);
+	// Point at the cropped rows in place rather than copying them out
+	std::unique_ptr<void*[]> crop_rows(new void*[h]);
 	for (int y = 0; y < h; y++)
-		for (int x = 0; x < w; x++)
-			crop[y * w + x] = in.image[(in_t + y) * in.w + (in_l + x)];
+		crop_rows[y] = (void*)&in.image[(in_t + y) * in.w + in_l];
 
 	// Create liq image
 	unsigned tgt_cols = highbpp ? 256 : 16;
@@ -46,7 +313,7 @@ void Quant::Generate(const Image &in, const RGBA *fixed, int in_l, int in_t, int
 		0) // liq_set_min_posterization(quant_attr, 3) != LIQ_OK)
 		throw RuntimeError("Failed to set quantization attributes");
 
-	liq_image *quant_image = liq_image_create_rgba(quant_attr, crop.get(), w, h, 0);
+	liq_image *quant_image = liq_image_create_rgba_rows(quant_attr, crop_rows.get(), w, h, 0);
 	if (quant_image == nullptr)
 		throw RuntimeError("Failed to create quantization image");
 	
@@ -73,22 +340,25 @@ void Quant::Generate(const Image &in, const RGBA *fixed, int in_l, int in_t, int
 		if (quant_palette == nullptr)
 			throw RuntimeError("Failed to write out quantized palette");
 		memcpy(palette, fixed, 256 * 4);
-				
-		for (int i = 0; i < (w * h); i++)
+
+		// Build the liq index to fixed index table once, then remap with one lookup per pixel
+		// Colours not in the fixed palette map to 0, and the first match wins, as with a linear search
+		uint8_t remap[256] = {};
+		for (unsigned f = 0; f < quant_palette->count && f < 256; f++)
 		{
-			uint8_t f = image[i];
-			uint8_t s = 0;
 			liq_color cump = quant_palette->entries[f];
 			for (unsigned j = 0; j < tgt_cols; j++)
 			{
 				if (fixed[j] == *((RGBA*)&cump))
 				{
-					s = j;
+					remap[f] = j;
 					break;
 				}
 			}
-			image[i] = s;
 		}
+
+		for (int i = 0; i < (w * h); i++)
+			image[i] = remap[image[i]];
 	}
 	else
 	{
@@ -105,6 +375,70 @@ void Quant::Generate(const Image &in, const RGBA *fixed, int in_l, int in_t, int
 	liq_attr_destroy(quant_attr);
 }
 
+void Quant::Histogram(const std::vector<const Image*> &in, unsigned sample, bool highbpp)
+{
+	if (sample == 0)
+		sample = 1;
+
+	// Create liq histogram
+	unsigned tgt_cols = highbpp ? 256 : 16;
+
+	liq_attr *quant_attr = liq_attr_create();
+	if (quant_attr == nullptr ||
+		liq_set_max_colors(quant_attr, tgt_cols) != LIQ_OK)
+		throw RuntimeError("Failed to set quantization attributes");
+
+	liq_histogram *quant_histogram = liq_histogram_create(quant_attr);
+	if (quant_histogram == nullptr)
+		throw RuntimeError("Failed to create quantization histogram");
+
+	// Add images
+	std::vector<RGBA> samples;
+	for (auto &i : in)
+	{
+		size_t count = size_t(i->w) * size_t(i->h);
+		if (count == 0)
+			continue;
+
+		// The histogram only counts colours, so samples are gathered into a single row
+		const RGBA *pixels = i->image.get();
+		int w = i->w, h = i->h;
+		if (sample > 1)
+		{
+			samples.clear();
+			for (size_t j = 0; j < count; j += sample)
+				samples.push_back(i->image[j]);
+			pixels = samples.data();
+			w = int(samples.size());
+			h = 1;
+		}
+
+		liq_image *quant_image = liq_image_create_rgba(quant_attr, pixels, w, h, 0);
+		if (quant_image == nullptr)
+			throw RuntimeError("Failed to create quantization image");
+		if (liq_histogram_add_image(quant_histogram, quant_attr, quant_image) != LIQ_OK)
+			throw RuntimeError("Failed to add image to quantization histogram");
+		liq_image_destroy(quant_image);
+	}
+
+	// Quantize histogram
+	liq_result *quant_result;
+	if (liq_histogram_quantize(quant_histogram, quant_attr, &quant_result) != LIQ_OK)
+		throw RuntimeError("Failed to quantize histogram");
+
+	// Write out palette
+	const liq_palette *quant_palette = liq_get_palette(quant_result);
+	if (quant_palette == nullptr)
+		throw RuntimeError("Failed to write out quantized palette");
+	memset(palette, 0, sizeof(palette));
+	memcpy(palette, quant_palette->entries, quant_palette->count * 4);
+
+	// Release
+	liq_result_destroy(quant_result);
+	liq_histogram_destroy(quant_histogram);
+	liq_attr_destroy(quant_attr);
+}
+
 // Algorithm
 void Algo::Generate(const Image &in, bool semi, int in_l, int in_t, int in_r, int in_b, int a_x, int a_y, float scale)
 {
@@ -118,7 +452,7 @@ void Algo::Generate(const Image &in, bool semi, int in_l, int in_t, int in_r, in
 		int in_h = in_b - in_t;
 		image.w = in_w;
 		image.h = in_h;
-		image.image.reset(new RGBA[in_w * in_h]);
+		image.image = Image::Alloc(in_w, in_h);
 		for (int y = 0; y < in_h; y++)
 			for (int x = 0; x < in_w; x++)
 				image.image[(y * in_w) + x] = in.image[((in_t + y) * in.w) + (in_l + x)];
@@ -140,20 +474,14 @@ void Algo::Generate(const Image &in, bool semi, int in_l, int in_t, int in_r, in
 		// Resize image
 		image.w = out_w;
 		image.h = out_h;
-		image.image.reset(new RGBA[out_w * out_h]);
+		image.image = Image::Alloc(out_w, out_h);
 		stbir_resize_subpixel(in.image.get() + (in_t * in.w + in_l), in_w, in_h, in.w * 4, image.image.get(), out_w, out_h, out_w * 4, STBIR_TYPE_UINT8, 4, 3, 0, STBIR_EDGE_ZERO, STBIR_EDGE_ZERO, STBIR_FILTER_CATMULLROM, STBIR_FILTER_CATMULLROM, STBIR_COLORSPACE_SRGB, nullptr, scale, scale, a_x_sub, a_y_sub);
 	}
 
 	if (!semi)
 	{
-		for (int i = 0; i < (image.w * image.h); i++)
-		{
-			// Quantize
-			if (image.image[i].a > 0x40)
-				image.image[i].a = 0xFF;
-			else
-				image.image[i].a = 0x00;
-		}
+		// Quantize
+		Kernel::AlphaThreshold(image.image.get(), size_t(image.w) * size_t(image.h));
 	}
 }
 
@@ -206,6 +534,269 @@ void Cropper::Compile(int tx, int ty, int w, int h)
 	}
 }
 
+void Cropper::Cover(const Quant &in, bool highbpp)
+{
+	// Get opaque colours
+	uint16_t cluts[256];
+	for (int i = 0; i < 256; i++)
+		cluts[i] = in.palette[i].ToPS1();
+
+	// Band edges are aligned so their DMAs stay inside the crop's
+	int align = highbpp ? 4 : 8;
+
+	std::vector<Crop> covered;
+	for (auto &i : crops)
+	{
+		size_t first = covered.size();
+		for (int by = 0; by < i.ch; by += TILE_DIM)
+		{
+			// Find opaque bounds of band
+			int bh = std::min(int(TILE_DIM), i.ch - by);
+			int x0 = i.cw, x1 = 0, y0 = bh, y1 = 0;
+			for (int y = 0; y < bh; y++)
+			{
+				const uint8_t *rowp = &in.image[((i.cy + by + y) * in.w) + i.cx];
+				for (int x = 0; x < i.cw; x++)
+				{
+					if (cluts[rowp[x]] == 0)
+						continue;
+					x0 = std::min(x0, x);
+					x1 = std::max(x1, x + 1);
+					y0 = std::min(y0, y);
+					y1 = std::max(y1, y + 1);
+				}
+			}
+			if (x0 >= x1)
+				continue;
+
+			x0 -= x0 % align;
+			x1 = std::min(i.cw, x1 + ((align - (x1 % align)) % align));
+
+			// Grow the last band if this one continues it
+			if (covered.size() > first)
+			{
+				Crop &last = covered.back();
+				if (last.cx == (i.cx + x0) && last.cw == (x1 - x0) && (last.cy + last.ch) == (i.cy + by + y0))
+				{
+					last.ch += y1 - y0;
+					continue;
+				}
+			}
+
+			covered.emplace_back(Crop{
+				i.tx, i.ty,
+				i.px, i.py,
+				i.sx + x0, i.sy + by + y0,
+				i.cx + x0, i.cy + by + y0,
+				x1 - x0, y1 - y0
+			});
+		}
+	}
+	crops = std::move(covered);
+}
+
+// VRAM allocator
+VramAllocator::Skyline::Skyline(int x0, int y0, int x1, int y1) : x0(x0), x1(x1), y1(y1)
+{
+	segments.push_back(Segment{ x0, x1 - x0, y0 });
+}
+
+int VramAllocator::Skyline::Height(int x, int w) const
+{
+	int y = 0;
+	for (auto &i : segments)
+		if (i.x < (x + w) && (i.x + i.w) > x && i.y > y)
+			y = i.y;
+	return y;
+}
+
+void VramAllocator::Skyline::Raise(int x, int w, int y)
+{
+	// Cut the span out of the segments it overlaps
+	std::vector<Segment> next;
+	for (auto &i : segments)
+	{
+		if (i.x < x)
+			next.push_back(Segment{ i.x, std::min(i.x + i.w, x) - i.x, i.y });
+		if ((i.x + i.w) > (x + w))
+		{
+			int l = std::max(i.x, x + w);
+			next.push_back(Segment{ l, (i.x + i.w) - l, i.y });
+		}
+	}
+	next.push_back(Segment{ x, w, y });
+	std::sort(next.begin(), next.end(), [](const Segment &a, const Segment &b) { return a.x < b.x; });
+
+	// Merge neighbours of the same height
+	segments.clear();
+	for (auto &i : next)
+	{
+		if (!segments.empty() && segments.back().y == i.y && (segments.back().x + segments.back().w) == i.x)
+			segments.back().w += i.w;
+		else
+			segments.push_back(i);
+	}
+}
+
+VramAllocator::VramAllocator(int fb_w, int fb_h) : textures(0, 0, VRAM_W, VRAM_H), cluts(0, fb_h, fb_w, VRAM_H)
+{
+	textures.Raise(0, fb_w, VRAM_H);
+	reserved.push_back(Rect{ 0, 0, fb_w, fb_h });
+}
+
+void VramAllocator::Footprint(int w, int h, bool highbpp, int &fw, int &fh)
+{
+	int tpp = highbpp ? 2 : 4;
+
+	Cropper cropper;
+	cropper.Compile(0, 0, w, h);
+
+	// Same rectangles DMA::Image writes
+	fw = 0;
+	fh = 0;
+	for (auto &i : cropper.crops)
+	{
+		int vram_w = (i.cw + tpp - 1) / tpp;
+		vram_w += (vram_w & 1);
+		fw = std::max(fw, ((i.px * 256) + i.sx) / tpp + vram_w);
+		fh = std::max(fh, (i.py * 256) + i.sy + i.ch);
+	}
+}
+
+bool VramAllocator::Place(Skyline &skyline, int w, int h, const std::function<bool(int, int&)> &legal, Rect &rect)
+{
+	// Try the left edge of every segment and every 16 unit boundary, keep the lowest then leftmost fit
+	std::set<int> xs;
+	for (auto &i : skyline.segments)
+		xs.insert(i.x);
+	for (int x = skyline.x0 + 15 - ((skyline.x0 + 15) & 15); x < skyline.x1; x += 16)
+		xs.insert(x);
+
+	bool found = false;
+	for (int x : xs)
+	{
+		if ((x + w) > skyline.x1)
+			break;
+		int y = skyline.Height(x, w);
+		if (!legal(x, y) || (y + h) > skyline.y1)
+			continue;
+		if (!found || y < rect.y)
+		{
+			rect = Rect{ x, y, w, h };
+			found = true;
+		}
+	}
+
+	if (found)
+		skyline.Raise(rect.x, rect.w, rect.y + rect.h);
+	return found;
+}
+
+bool VramAllocator::Texture(int w, int h, bool highbpp, int &tx, int &ty)
+{
+	int tpp = highbpp ? 2 : 4;
+	int page_w = 256 / tpp;
+
+	int fw, fh;
+	Footprint(w, h, highbpp, fw, fh);
+
+	auto legal = [&](int x, int &y)
+	{
+		// Frames wider than a page start on one, smaller frames must not cross one
+		int sx = x % page_w;
+		if (w > 0xFF)
+		{
+			if (sx != 0)
+				return false;
+		}
+		else if ((sx * tpp) + w > 0xFF || (sx + fw) > page_w)
+		{
+			return false;
+		}
+
+		// Likewise for rows
+		if (h > 0xFF || ((y & 0xFF) + h) > 0xFF)
+			y = (y + 0xFF) & ~0xFF;
+		return true;
+	};
+
+	Rect rect;
+	if (!Place(textures, fw, fh, legal, rect))
+		return false;
+	texture_rects.push_back(rect);
+
+	tx = rect.x;
+	ty = rect.y;
+	return true;
+}
+
+bool VramAllocator::Clut(bool highbpp, int &cx, int &cy)
+{
+	int w = highbpp ? 256 : 16;
+	auto legal = [](int x, int &) { return (x & 15) == 0; };
+
+	// Fall back to texture space once the rows below the framebuffer are full
+	Rect rect;
+	if (!Place(cluts, w, 1, legal, rect) && !Place(textures, w, 1, legal, rect))
+		return false;
+	clut_rects.push_back(rect);
+
+	cx = rect.x;
+	cy = rect.y;
+	return true;
+}
+
+void VramAllocator::Report(std::ostream &stream) const
+{
+	auto area = [](const std::vector<Rect> &rects)
+	{
+		size_t a = 0;
+		for (auto &i : rects)
+			a += size_t(i.w) * size_t(i.h);
+		return a;
+	};
+
+	size_t free_area = size_t(VRAM_W) * size_t(VRAM_H) - area(reserved);
+	size_t texture_area = area(texture_rects);
+	size_t clut_area = area(clut_rects);
+
+	stream << "VRAM: " << texture_rects.size() << " textures in " << texture_area << ", "
+		<< clut_rects.size() << " CLUTs in " << clut_area << ", "
+		<< (100 * (texture_area + clut_area) / free_area) << "% of " << free_area << " outside the framebuffer" << std::endl;
+
+	// Occupancy of every 64x256 texture page
+	for (int py = 0; py < VRAM_H; py += 256)
+	{
+		stream << "  y " << py << ":";
+		for (int px = 0; px < VRAM_W; px += 64)
+		{
+			auto cover = [&](const std::vector<Rect> &rects)
+			{
+				size_t a = 0;
+				for (auto &i : rects)
+				{
+					int l = std::max(i.x, px), r = std::min(i.x + i.w, px + 64);
+					int t = std::max(i.y, py), b = std::min(i.y + i.h, py + 256);
+					if (l < r && t < b)
+						a += size_t(r - l) * size_t(b - t);
+				}
+				return a;
+			};
+
+			// Percent of the part of the page outside the framebuffer
+			size_t page = 64 * 256 - cover(reserved);
+			if (page == 0)
+			{
+				stream << "   fb";
+				continue;
+			}
+			std::string used = std::to_string(100 * (cover(texture_rects) + cover(clut_rects)) / page);
+			stream << " " << std::string(3 - std::min<size_t>(used.size(), 3), ' ') << used << "%";
+		}
+		stream << std::endl;
+	}
+}
+
 // Anim function
 void Anim::Out(std::vector<Anim> &anims, std::ostream &stream)
 {
@@ -267,14 +858,12 @@ DMA DMA::Image(const Quant &quant, Crop crop, bool highbpp)
 	if (highbpp)
 	{
 		for (uint32_t y = 0, srcy = crop.cy; y < crop.ch; y++, srcy++)
-			for (uint32_t x = 0, srcx = crop.cx; x < crop.cw; x++, srcx++)
-				dma.data[(y * vram_w * 2) + x] = quant.image[(srcy * quant.w) + srcx];
+			memcpy(&dma.data[y * vram_w * 2], &quant.image[(srcy * quant.w) + crop.cx], crop.cw);
 	}
 	else
 	{
 		for (uint32_t y = 0, srcy = crop.cy; y < crop.ch; y++, srcy++)
-			for (uint32_t x = 0, srcx = crop.cx; x < crop.cw; x++, srcx++)
-				dma.data[(y * vram_w * 2) + (x >> 1)] |= (quant.image[(srcy * quant.w) + srcx] << ((x & 1) ? 4 : 0));
+			Kernel::PackNibbles(&dma.data[y * vram_w * 2], &quant.image[(srcy * quant.w) + crop.cx], crop.cw);
 	}
 
 	dma.AlignBCR();
@@ -303,6 +892,126 @@ DMA DMA::Palette(const Quant &quant, bool highbpp)
 	return dma;
 }
 
+DMA DMA::Clone() const
+{
+	DMA dma;
+	dma.x = x;
+	dma.y = y;
+	dma.w = w;
+	dma.h = h;
+	dma.compress = compress;
+	dma.size = size;
+	dma.bcr = bcr;
+	dma.data.reset(new uint8_t[size]);
+	memcpy(dma.data.get(), data.get(), size);
+	return dma;
+}
+
+std::vector<DMA> DMA::Delta(const std::vector<DMA> &from, const std::vector<DMA> &to)
+{
+	// Model VRAM after from and after to
+	// Texels from didn't write hold whatever was there before, so they always count as changed
+	std::vector<uint16_t> vram_from(VRAM_W * VRAM_H), vram_to(VRAM_W * VRAM_H);
+	std::vector<uint8_t> known(VRAM_W * VRAM_H);
+
+	auto Apply = [](std::vector<uint16_t> &vram, std::vector<uint8_t> *mask, const DMA &dma)
+	{
+		if (dma.compress != 0)
+			throw RuntimeError("DMA::Delta can't read compressed DMAs");
+		if ((dma.x + dma.w) > uint32_t(VRAM_W) || (dma.y + dma.h) > uint32_t(VRAM_H))
+			throw RuntimeError("DMA outside VRAM");
+		for (uint32_t y = 0; y < dma.h; y++)
+		{
+			for (uint32_t x = 0; x < dma.w; x++)
+			{
+				const uint8_t *datap = &dma.data[((y * dma.w) + x) * 2];
+				vram[((dma.y + y) * VRAM_W) + dma.x + x] = datap[0] | (datap[1] << 8);
+				if (mask != nullptr)
+					(*mask)[((dma.y + y) * VRAM_W) + dma.x + x] = 1;
+			}
+		}
+	};
+
+	for (auto &i : from)
+		Apply(vram_from, &known, i);
+	for (auto &i : to)
+		Apply(vram_to, nullptr, i);
+
+	// Changed spans of each TILE_DIM row band of every to DMA
+	std::vector<DMA> dmas;
+	for (auto &i : to)
+	{
+		uint32_t band_x0 = 0, band_x1 = 0, band_y = 0, band_h = 0;
+		auto Flush = [&]()
+		{
+			if (band_h == 0)
+				return;
+
+			DMA dma;
+			dma.x = band_x0;
+			dma.y = band_y;
+			dma.w = band_x1 - band_x0;
+			dma.h = band_h;
+			dma.size = (dma.w * 2) * dma.h;
+			dma.data.reset(new uint8_t[dma.size]);
+			for (uint32_t y = 0; y < dma.h; y++)
+			{
+				for (uint32_t x = 0; x < dma.w; x++)
+				{
+					uint16_t texel = vram_to[((dma.y + y) * VRAM_W) + dma.x + x];
+					dma.data[((y * dma.w) + x) * 2 + 0] = texel >> 0;
+					dma.data[((y * dma.w) + x) * 2 + 1] = texel >> 8;
+				}
+			}
+			dma.AlignBCR();
+			dmas.push_back(std::move(dma));
+			band_h = 0;
+		};
+
+		for (uint32_t by = 0; by < i.h; by += TILE_DIM)
+		{
+			uint32_t bh = std::min(TILE_DIM, i.h - by);
+			uint32_t x0 = i.w, x1 = 0, y0 = bh, y1 = 0;
+			for (uint32_t y = 0; y < bh; y++)
+			{
+				size_t rowi = ((i.y + by + y) * VRAM_W) + i.x;
+				for (uint32_t x = 0; x < i.w; x++)
+				{
+					if (known[rowi + x] && vram_from[rowi + x] == vram_to[rowi + x])
+						continue;
+					x0 = std::min(x0, x);
+					x1 = std::max(x1, x + 1);
+					y0 = std::min(y0, y);
+					y1 = std::max(y1, y + 1);
+				}
+			}
+			if (x0 >= x1)
+			{
+				Flush();
+				continue;
+			}
+
+			// Keep transfers an even width, inside the to DMA
+			x0 &= ~1U;
+			x1 = std::min(i.w, x1 + (x1 & 1));
+
+			// Grow the last band if this one continues it
+			if (band_h != 0 && band_x0 == (i.x + x0) && band_x1 == (i.x + x1) && (band_y + band_h) == (i.y + by + y0))
+			{
+				band_h += y1 - y0;
+				continue;
+			}
+			Flush();
+			band_x0 = i.x + x0;
+			band_x1 = i.x + x1;
+			band_y = i.y + by + y0;
+			band_h = y1 - y0;
+		}
+		Flush();
+	}
+	return dmas;
+}
+
 void DMA::AlignBCR()
 {
 	// Calculate BCR
@@ -334,16 +1043,267 @@ void DMA::AlignBCR()
 
 }
 
-void DMA::Compress()
+std::vector<DMA> DMA::Bands() const
+{
+	if (compress != 0)
+		throw RuntimeError("DMA::Bands can't split compressed DMAs");
+
+	std::vector<DMA> bands;
+	if (size <= STREAM_BAND_SIZE)
+	{
+		bands.push_back(Clone());
+		return bands;
+	}
+
+	// Split into as many whole rows as fit
+	uint32_t pitch = w * 2;
+	uint32_t rows = STREAM_BAND_SIZE / pitch;
+	for (uint32_t y = 0; y < h; y += rows)
+	{
+		DMA band;
+		band.x = x;
+		band.y = y + this->y;
+		band.w = w;
+		band.h = std::min(rows, h - y);
+		band.size = pitch * band.h;
+		band.data.reset(new uint8_t[band.size]);
+		memcpy(band.data.get(), &data[y * pitch], band.size);
+		band.AlignBCR();
+		bands.push_back(std::move(band));
+	}
+	return bands;
+}
+
+// Compressor buffers, one set per thread so workers can compress at once
+// Kept for the life of the thread so they're only allocated for the first DMA
+struct CompressContext
+{
+	ClownLZSS_Context context;
+
+	CompressContext() { ClownLZSS_Context_Init(&context); }
+	~CompressContext() { ClownLZSS_Context_Destroy(&context); }
+};
+
+void DMA::Compress(Codec codec)
 {
+	static thread_local CompressContext compress_context;
+
+	if (codec == Codec::None)
+		return;
+
 	uint32_t osize = size;
-	size_t comper_size;
-	unsigned char *comper = ClownLZSS_ComperCompress(data.get(), size, &comper_size);
-	data.reset(new uint8_t[comper_size]);
-	size = comper_size;
-	compress = osize;
-	memcpy(data.get(), comper, comper_size);
-	free(comper);
+	if (osize > STREAM_BAND_SIZE)
+		throw RuntimeError("DMA too large to compress, it must be split into bands");
+
+	size_t packed_size;
+	unsigned char *packed;
+	if (codec == Codec::LZB)
+		packed = ClownLZSS_LZBCompressWithContext(&compress_context.context, data.get(), size, &packed_size);
+	else
+		packed = ClownLZSS_ComperCompressWithContext(&compress_context.context, data.get(), size, &packed_size);
+
+	DMA compressed;
+	compressed.data.reset(new uint8_t[packed_size]);
+	compressed.size = packed_size;
+	compressed.compress = osize | ((codec == Codec::LZB) ? COMPRESS_LZB : 0);
+	memcpy(compressed.data.get(), packed, packed_size);
+	free(packed);
+
+	// Check the round trip
+	std::vector<uint8_t> decompressed = compressed.Decompress();
+	if (memcmp(decompressed.data(), data.get(), osize) != 0)
+		throw RuntimeError("DMA didn't decompress to what was compressed");
+
+	data = std::move(compressed.data);
+	size = compressed.size;
+	compress = compressed.compress;
+}
+
+std::vector<uint8_t> DMA::Decompress() const
+{
+	std::vector<uint8_t> out(RawSize());
+	bool valid = true;
+	switch (GetCodec())
+	{
+		case Codec::None:
+			memcpy(out.data(), data.get(), size);
+			break;
+		case Codec::Comper:
+			valid = ClownLZSS_ComperDecompress(data.get(), size, out.data(), out.size());
+			break;
+		case Codec::LZB:
+			valid = ClownLZSS_LZBDecompress(data.get(), size, out.data(), out.size());
+			break;
+	}
+	if (!valid)
+		throw RuntimeError("DMA isn't a valid compressed stream");
+	return out;
+}
+
+bool DMA::Compress(double budget, unsigned uses)
+{
+	// Weigh the bytes saved against decompressing on every upload
+	DMA best;
+	double best_gain = 0.0;
+
+	for (Codec codec : { Codec::Comper, Codec::LZB })
+	{
+		DMA compressed = Clone();
+		compressed.Compress(codec);
+
+		double saved = double(size) - double(compressed.size);
+		double gain = (budget * saved) - (uses * compressed.DecompressCycles());
+		if (saved > 0.0 && gain >= 0.0 && (best.data == nullptr || gain > best_gain))
+		{
+			best = std::move(compressed);
+			best_gain = gain;
+		}
+	}
+
+	if (best.data == nullptr)
+		return false;
+	*this = std::move(best);
+	return true;
+}
+
+void DMA::Add(std::vector<DMA> &dmas, DMA dma, Codec codec)
+{
+	if (codec == Codec::None)
+	{
+		dmas.push_back(std::move(dma));
+		return;
+	}
+
+	for (auto &i : dma.Bands())
+	{
+		i.Compress(codec);
+		dmas.push_back(std::move(i));
+	}
+}
+
+unsigned DMA::Compress(std::vector<DMA> &dmas, double budget, unsigned uses)
+{
+	std::vector<DMA> out;
+	unsigned compressed = 0;
+	for (auto &i : dmas)
+	{
+		if (i.compress != 0)
+		{
+			out.push_back(std::move(i));
+			continue;
+		}
+
+		std::vector<DMA> bands = i.Bands();
+		unsigned bands_compressed = 0;
+		for (auto &j : bands)
+			if (j.Compress(budget, uses))
+				bands_compressed++;
+
+		// Uncompressed bands are only more transfers
+		if (bands_compressed == 0)
+		{
+			out.push_back(std::move(i));
+			continue;
+		}
+		for (auto &j : bands)
+			out.push_back(std::move(j));
+		compressed += bands_compressed;
+	}
+	dmas = std::move(out);
+	return compressed;
+}
+
+double DMA::DecodeCycles() const
+{
+	const uint8_t *in = data.get();
+	double cycles = 0.0;
+
+	if (GetCodec() == Codec::LZB)
+	{
+		// Compress::DecompressLZB
+		auto extend = [&](size_t &value)
+		{
+			if (value != 15)
+				return;
+			uint8_t byte;
+			do
+			{
+				byte = *in++;
+				value += byte;
+				cycles += 5;
+			} while (byte == 0xFF);
+		};
+		auto copy = [&](size_t length, size_t offset)
+		{
+			// Words, then the remaining bytes, unless the offset is 3
+			if (offset == 3 || length < 4)
+				return 6.0 * length;
+			return (((offset < 3) ? 6.0 : 9.0) * (length / 4)) + 2 + (6.0 * (length & 3));
+		};
+
+		cycles += 2;
+		for (;;)
+		{
+			size_t literals = *in >> 4, length = *in & 0xF;
+			in++;
+			cycles += 5;
+			if (literals != 0)
+			{
+				extend(literals);
+				cycles += 2 + 3 + copy(literals, 4);
+				in += literals;
+			}
+
+			size_t offset = in[0] | (in[1] << 8);
+			in += 2;
+			cycles += 7;
+			if (offset == 0)
+				break;
+
+			extend(length);
+			length += 4;
+			cycles += 2 + 3 + ((offset < 4) ? 3 : 0) + ((offset < 3) ? 7 : 0) + copy(length, offset);
+			if (offset < 4 || (length & 3))
+				cycles += 2; // Branch back to .Llzb_sequence
+		}
+	}
+	else if (GetCodec() == Codec::Comper)
+	{
+		// Compress::Decompress, a description word of 32 flags followed by a word for each
+		auto read = [&]()
+		{
+			uint32_t x = in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+			in += 4;
+			return x;
+		};
+
+		for (;;)
+		{
+			uint32_t description = read();
+			cycles += 5;
+
+			for (unsigned bit = 0; bit < 32; bit++)
+			{
+				uint32_t word = read();
+				if (!(description & (0x80000000 >> bit)))
+				{
+					cycles += 8;
+					continue;
+				}
+
+				cycles += 6;
+				if (word == 0)
+					return cycles;
+
+				// Duff's device, entered part way into its first 64 copies
+				size_t length = (word >> 16) + 1;
+				bool rle = (word & 0xFFFF) == 0xFFFC;
+				cycles += 2 + (rle ? 9 : 12) + ((rle ? 1 : 3) * length) + (3 * (((length - 1) >> 6) + 1)) + 2;
+			}
+			cycles += 2; // Branch back to .Lnewblock
+		}
+	}
+	return cycles;
 }
 
 void DMA::Out(std::vector<DMA> &dmas, std::ostream &stream)
@@ -374,6 +1334,39 @@ void DMA::Out(std::vector<DMA> &dmas, std::ostream &stream)
 	}
 }
 
+void DMA::Save(const std::vector<DMA> &dmas, std::ostream &stream)
+{
+	Write32(stream, dmas.size());
+	for (auto &i : dmas)
+	{
+		Write32(stream, i.x); Write32(stream, i.y);
+		Write32(stream, i.w); Write32(stream, i.h);
+		Write32(stream, i.compress);
+		Write32(stream, i.size);
+		Write32(stream, i.bcr);
+		stream.write((const char*)i.data.get(), i.size);
+	}
+}
+
+void DMA::Load(std::vector<DMA> &dmas, std::istream &stream)
+{
+	uint32_t ndmas = Read32(stream);
+	for (uint32_t j = 0; j < ndmas; j++)
+	{
+		DMA dma;
+		dma.x = Read32(stream); dma.y = Read32(stream);
+		dma.w = Read32(stream); dma.h = Read32(stream);
+		dma.compress = Read32(stream);
+		dma.size = Read32(stream);
+		dma.bcr = Read32(stream);
+		dma.data.reset(new uint8_t[dma.size]);
+		stream.read((char*)dma.data.get(), dma.size);
+		dmas.push_back(std::move(dma));
+	}
+	if (!stream)
+		throw RuntimeError("Truncated DMA list");
+}
+
 size_t DMA::Size(std::vector<DMA> &dmas)
 {
 	size_t size = 4 + (dmas.size() * (4 * 6));
@@ -388,8 +1381,160 @@ size_t DMA::Size(std::vector<DMA> &dmas)
 }
 
 
+// Tile dictionary functions
+std::vector<TileDictionary::Ref> TileDictionary::Add(const Quant &in)
+{
+	// Get transparent colours
+	uint16_t cluts[256];
+	for (int i = 0; i < 256; i++)
+		cluts[i] = in.palette[i].ToPS1();
+
+	std::vector<Ref> refs;
+	for (int y = 0; y < in.h; y += TILE_DIM)
+	{
+		for (int x = 0; x < in.w; x += TILE_DIM)
+		{
+			// Read tile
+			Tile tile;
+			tile.w = std::min(int(TILE_DIM), in.w - x);
+			tile.h = std::min(int(TILE_DIM), in.h - y);
+			tile.pixels.resize(TILE_DIM * TILE_DIM);
+
+			bool empty = true;
+			for (int j = 0; j < tile.h; j++)
+			{
+				const uint8_t *srcp = &in.image[((y + j) * in.w) + x];
+				uint8_t *dstp = &tile.pixels[j * TILE_DIM];
+				for (int i = 0; i < tile.w; i++)
+				{
+					dstp[i] = srcp[i];
+					if (cluts[srcp[i]] != 0)
+						empty = false;
+				}
+			}
+			if (empty)
+				continue;
+
+			// Find identical tile
+			Hash::Hash64 hash = Hash::FromBuffer64(tile.pixels.data(), tile.pixels.size());
+			hash = Hash::FromBuffer64((const uint8_t*)&tile.w, sizeof(tile.w), hash);
+			hash = Hash::FromBuffer64((const uint8_t*)&tile.h, sizeof(tile.h), hash);
+
+			unsigned index = tiles.size();
+			auto range = tiles_find.equal_range(hash);
+			for (auto i = range.first; i != range.second; i++)
+			{
+				const Tile &other = tiles[i->second];
+				if (other.w == tile.w && other.h == tile.h && other.pixels == tile.pixels)
+				{
+					index = i->second;
+					break;
+				}
+			}
+			if (index == tiles.size())
+			{
+				tiles_find.emplace(hash, index);
+				tiles.push_back(std::move(tile));
+			}
+
+			refs.push_back(Ref{ x, y, index });
+		}
+	}
+	return refs;
+}
+
+Crop TileDictionary::Cell(unsigned tile, int tx, int ty) const
+{
+	if ((tx & 0xFF) != 0 || (ty & 0xFF) != 0)
+		throw RuntimeError("Tiled frames must be placed on a texture page");
+
+	// Pages of TILE_FIT x TILE_FIT cells, left to right
+	unsigned page = tile / (TILE_FIT * TILE_FIT);
+	unsigned cell = tile % (TILE_FIT * TILE_FIT);
+
+	int px = (tx >> 8) + page;
+	int py = ty >> 8;
+	int sx = (cell % TILE_FIT) * TILE_DIM;
+	int sy = (cell / TILE_FIT) * TILE_DIM;
+	return Crop{ tx, ty, px, py, sx, sy, 0, 0, tiles[tile].w, tiles[tile].h };
+}
+
+std::vector<DMA> TileDictionary::Atlas(Codec compress, bool highbpp, int tx, int ty) const
+{
+	if (highbpp)
+		tx <<= 1;
+	else
+		tx <<= 2;
+
+	std::vector<DMA> dmas;
+	for (unsigned first = 0; first < tiles.size(); first += TILE_FIT * TILE_FIT)
+	{
+		// Lay out this page's tiles
+		unsigned count = std::min(unsigned(tiles.size()) - first, TILE_FIT * TILE_FIT);
+
+		Quant page;
+		page.w = std::min(count, TILE_FIT) * TILE_DIM;
+		page.h = ((count + TILE_FIT - 1) / TILE_FIT) * TILE_DIM;
+		page.image.reset(new uint8_t[page.w * page.h]{});
+
+		for (unsigned i = first; i < (first + count); i++)
+		{
+			Crop cell = Cell(i, tx, ty);
+			for (unsigned j = 0; j < TILE_DIM; j++)
+				memcpy(&page.image[((cell.sy + j) * page.w) + cell.sx], &tiles[i].pixels[j * TILE_DIM], TILE_DIM);
+		}
+
+		// DMA page
+		Crop crop = Cell(first, tx, ty);
+		if ((crop.px << (highbpp ? 7 : 6)) + (page.w >> (highbpp ? 1 : 2)) > VRAM_W)
+			throw RuntimeError("Tile atlas doesn't fit in VRAM (" + std::to_string(tiles.size()) + " tiles)");
+		crop.cw = page.w;
+		crop.ch = page.h;
+
+		DMA::Add(dmas, DMA::Image(page, crop, highbpp), compress);
+	}
+	return dmas;
+}
+
 // Mesh function
-void Mesh::Compile(const Quant &in, bool compress, bool highbpp, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty)
+static Poly CropPoly(const Crop &crop, bool highbpp, int semi, int ax, int ay, int clutx, int cluty)
+{
+	Poly poly;
+	poly.poly.tpage = crop.GetTPage(highbpp);
+	if (highbpp)
+		poly.poly.tpage |= (1 << 7);
+	if (semi >= 0)
+		poly.poly.tpage |= (semi << 5);
+	poly.poly.clut = (cluty * (1024 / 16)) + (clutx / 16);
+
+	poly.v0.x = crop.cx - ax;
+	poly.v0.y = crop.cy - ay;
+	poly.v0.z = 0;
+	poly.poly.u0 = crop.sx;
+	poly.poly.v0 = crop.sy;
+
+	poly.v1.x = (crop.cx + crop.cw) - ax;
+	poly.v1.y = crop.cy - ay;
+	poly.v1.z = 0;
+	poly.poly.u1 = crop.sx + crop.cw;
+	poly.poly.v1 = crop.sy;
+
+	poly.v2.x = crop.cx - ax;
+	poly.v2.y = (crop.cy + crop.ch) - ay;
+	poly.v2.z = 0;
+	poly.poly.u2 = crop.sx;
+	poly.poly.v2 = crop.sy + crop.ch;
+
+	poly.v3.x = (crop.cx + crop.cw) - ax;
+	poly.v3.y = (crop.cy + crop.ch) - ay;
+	poly.v3.z = 0;
+	poly.poly.u3 = crop.sx + crop.cw;
+	poly.poly.v3 = crop.sy + crop.ch;
+
+	return poly;
+}
+
+void Mesh::Compile(const Quant &in, Codec compress, bool highbpp, bool coverage, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty)
 {
 	// Generate crops
 	if (highbpp)
@@ -399,54 +1544,17 @@ void Mesh::Compile(const Quant &in, bool compress, bool highbpp, int semi, int a
 	
 	Cropper cropper;
 	cropper.Compile(tx, ty, in.w, in.h);
+	if (coverage)
+		cropper.Cover(in, highbpp);
 
 	// Crop images
 	for (auto &i : cropper.crops)
 	{
 		// Create polygon
-		{
-			Poly poly;
-			poly.poly.tpage = i.GetTPage(highbpp);
-			if (highbpp)
-				poly.poly.tpage |= (1 << 7);
-			if (semi >= 0)
-				poly.poly.tpage |= (semi << 5);
-			poly.poly.clut = (cluty * (1024 / 16)) + (clutx / 16);
-
-			poly.v0.x = i.cx - ax;
-			poly.v0.y = i.cy - ay;
-			poly.v0.z = 0;
-			poly.poly.u0 = i.sx;
-			poly.poly.v0 = i.sy;
-
-			poly.v1.x = (i.cx + i.cw) - ax;
-			poly.v1.y = i.cy - ay;
-			poly.v1.z = 0;
-			poly.poly.u1 = i.sx + i.cw;
-			poly.poly.v1 = i.sy;
-
-			poly.v2.x = i.cx - ax;
-			poly.v2.y = (i.cy + i.ch) - ay;
-			poly.v2.z = 0;
-			poly.poly.u2 = i.sx;
-			poly.poly.v2 = i.sy + i.ch;
-
-			poly.v3.x = (i.cx + i.cw) - ax;
-			poly.v3.y = (i.cy + i.ch) - ay;
-			poly.v3.z = 0;
-			poly.poly.u3 = i.sx + i.cw;
-			poly.poly.v3 = i.sy + i.ch;
-
-			polys.push_back(poly);
-		}
+		polys.push_back(CropPoly(i, highbpp, semi, ax, ay, clutx, cluty));
 
 		// DMA image
-		{
-			DMA image = std::move(DMA::Image(in, i, highbpp));
-			if (compress)
-				image.Compress();
-			dmas.push_back(std::move(image));
-		}
+		DMA::Add(dmas, DMA::Image(in, i, highbpp), compress);
 	}
 	
 	// DMA palette
@@ -456,12 +1564,55 @@ void Mesh::Compile(const Quant &in, bool compress, bool highbpp, int semi, int a
 	dmas.push_back(std::move(palette));
 }
 
+void Mesh::CompileTiled(const TileDictionary &dictionary, const std::vector<TileDictionary::Ref> &refs, bool highbpp, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty)
+{
+	if (highbpp)
+		tx <<= 1;
+	else
+		tx <<= 2;
+
+	// One poly per tile
+	for (auto &i : refs)
+	{
+		Crop cell = dictionary.Cell(i.tile, tx, ty);
+		cell.cx = i.x;
+		cell.cy = i.y;
+		polys.push_back(CropPoly(cell, highbpp, semi, ax, ay, clutx, cluty));
+	}
+}
+
 void Mesh::Out(std::ostream &stream)
 {
 	Write32(stream, polys.size());
+
+	// Bounding box of every poly, for culling
+	int16_t x0 = INT16_MAX, y0 = INT16_MAX, x1 = INT16_MIN, y1 = INT16_MIN;
+	for (auto &i : polys)
+	{
+		for (const Vector *v : { &i.v0, &i.v1, &i.v2, &i.v3 })
+		{
+			x0 = std::min(x0, v->x);
+			y0 = std::min(y0, v->y);
+			x1 = std::max(x1, v->x);
+			y1 = std::max(y1, v->y);
+		}
+	}
+	if (polys.empty())
+		x0 = y0 = x1 = y1 = 0;
+
+	Write16(stream, x0);
+	Write16(stream, y0);
+	Write16(stream, x1);
+	Write16(stream, y1);
 	
 	for (auto &i : polys)
 	{
+		// The vertices' pads hold the poly's own bounding box, the GTE doesn't read them
+		int16_t px0 = std::min({ i.v0.x, i.v1.x, i.v2.x, i.v3.x });
+		int16_t py0 = std::min({ i.v0.y, i.v1.y, i.v2.y, i.v3.y });
+		int16_t px1 = std::max({ i.v0.x, i.v1.x, i.v2.x, i.v3.x });
+		int16_t py1 = std::max({ i.v0.y, i.v1.y, i.v2.y, i.v3.y });
+
 		Write8(stream, i.poly.u0);
 		Write8(stream, i.poly.v0);
 		Write16(stream, i.poly.clut);
@@ -482,36 +1633,81 @@ void Mesh::Out(std::ostream &stream)
 		Write16(stream, i.v0.y);
 
 		Write16(stream, i.v0.z);
-		Write16(stream, i.v0.pad);
+		Write16(stream, px0);
 		
 		Write16(stream, i.v1.x);
 		Write16(stream, i.v1.y);
 
 		Write16(stream, i.v1.z);
-		Write16(stream, i.v1.pad);
+		Write16(stream, py0);
 		
 		Write16(stream, i.v2.x);
 		Write16(stream, i.v2.y);
 
 		Write16(stream, i.v2.z);
-		Write16(stream, i.v2.pad);
+		Write16(stream, px1);
 		
 		Write16(stream, i.v3.x);
 		Write16(stream, i.v3.y);
 
 		Write16(stream, i.v3.z);
-		Write16(stream, i.v3.pad);
+		Write16(stream, py1);
 	}
 }
 
+void Mesh::In(std::istream &stream)
+{
+	uint32_t npolys = Read32(stream);
+	for (int j = 0; j < 4; j++)
+		Read16(stream); // Bounding box, made again by Out
+	for (uint32_t j = 0; j < npolys; j++)
+	{
+		Poly i;
+		i.poly.u0 = Read8(stream);
+		i.poly.v0 = Read8(stream);
+		i.poly.clut = Read16(stream);
+
+		i.poly.u1 = Read8(stream);
+		i.poly.v1 = Read8(stream);
+		i.poly.tpage = Read16(stream);
+
+		i.poly.u2 = Read8(stream);
+		i.poly.v2 = Read8(stream);
+		i.poly.pad1 = Read16(stream);
+
+		i.poly.u3 = Read8(stream);
+		i.poly.v3 = Read8(stream);
+		i.poly.pad2 = Read16(stream);
+
+		for (Vector *v : { &i.v0, &i.v1, &i.v2, &i.v3 })
+		{
+			v->x = Read16(stream);
+			v->y = Read16(stream);
+			v->z = Read16(stream);
+			v->pad = Read16(stream);
+		}
+		polys.push_back(i);
+	}
+	if (!stream)
+		throw RuntimeError("Truncated mesh");
+}
+
 size_t Mesh::Size()
 {
-	size_t size = 4 + (polys.size() * sizeof(Poly));
+	size_t size = 4 + (4 * 2) + (polys.size() * sizeof(Poly));
 	return size;
 }
 
+size_t Mesh::Fill() const
+{
+	size_t fill = 0;
+	for (auto &i : polys)
+		fill += size_t(i.v1.x - i.v0.x) * size_t(i.v2.y - i.v0.y);
+	return fill;
+}
+
 // Sprite function
-void Sprites::Compile(const Quant &in, bool compress, bool highbpp, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty)
+void Sprites::Compile(const Quant &in, Codec compress, bool highbpp, bool coverage, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty)
 {
 	// Generate crops
 	if (highbpp)
@@ -521,6 +1717,8 @@ void Sprites::Compile(const Quant &in, bool compress, bool highbpp, int semi, in
 
 	Cropper cropper;
 	cropper.Compile(tx, ty, in.w, in.h);
+	if (coverage)
+		cropper.Cover(in, highbpp);
 
 	// Crop images
 	for (auto &i : cropper.crops)
@@ -547,12 +1745,7 @@ void Sprites::Compile(const Quant &in, bool compress, bool highbpp, int semi, in
 		}
 
 		// DMA image
-		{
-			DMA image = std::move(DMA::Image(in, i, highbpp));
-			if (compress)
-				image.Compress();
-			dmas.push_back(std::move(image));
-		}
+		DMA::Add(dmas, DMA::Image(in, i, highbpp), compress);
 	}
 
 	// DMA palette
@@ -580,8 +1773,136 @@ void Sprites::Out(std::ostream &stream)
 	}
 }
 
+void Sprites::In(std::istream &stream)
+{
+	uint32_t nsprites = Read32(stream);
+	for (uint32_t j = 0; j < nsprites; j++)
+	{
+		Sprite i;
+		i.tpage = Read16(stream);
+		i.pad = Read16(stream);
+		i.x = Read16(stream);
+		i.y = Read16(stream);
+		i.u = Read8(stream);
+		i.v = Read8(stream);
+		i.clut = Read16(stream);
+		i.w = Read16(stream);
+		i.h = Read16(stream);
+		sprites.push_back(i);
+	}
+	if (!stream)
+		throw RuntimeError("Truncated sprites");
+}
+
 size_t Sprites::Size()
 {
 	size_t size = 4 + (sprites.size() * sizeof(Sprite));
 	return size;
 }
+
+size_t Sprites::Fill() const
+{
+	size_t fill = 0;
+	for (auto &i : sprites)
+		fill += size_t(i.w) * size_t(i.h);
+	return fill;
+}
+
+// Frame cache
+FrameCache::Key::Pixels FrameCache::Key::HashPixels(const Image &image, int in_l, int in_t, int in_r, int in_b)
+{
+	// Hash rather than store the rectangle, so the key stays small and Load's full key check can't be fooled by a collision
+	Hash::Sha256 sha;
+	for (int y = in_t; y < in_b; y++)
+		sha.Update(&image.image[(y * image.w) + in_l], (in_r - in_l) * sizeof(RGBA));
+
+	Pixels pixels;
+	pixels.w = in_r - in_l;
+	pixels.h = in_b - in_t;
+	pixels.digest = sha.Final();
+	return pixels;
+}
+
+static const char FRAMECACHE_MAGIC[4] = { 'F', 'C', 'H', 'E' };
+
+static std::string FrameCachePath(const std::string &dir, const FrameCache::Key &key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.fch", (unsigned long long)key.Hash());
+	return dir + "/" + name;
+}
+
+FrameCache::FrameCache(std::string _dir) : dir(_dir)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+	if (ec)
+		throw RuntimeError("Failed to create frame cache " + dir);
+}
+
+bool FrameCache::Load(const Key &key, std::string &payload)
+{
+	std::ifstream stream(FrameCachePath(dir, key), std::ios::binary);
+	if (stream)
+	{
+		// Check header and full key, so hash collisions and stale entries miss
+		char magic[4] = {};
+		stream.read(magic, 4);
+		uint32_t key_size = Read32(stream);
+		if (stream && memcmp(magic, FRAMECACHE_MAGIC, 4) == 0 && key_size == key.data.size())
+		{
+			std::string key_data(key_size, '\0');
+			stream.read(&key_data[0], key_size);
+			uint32_t payload_size = Read32(stream);
+			if (stream && key_data == key.data)
+			{
+				payload.assign(payload_size, '\0');
+				stream.read(&payload[0], payload_size);
+				if (stream)
+				{
+					hits++;
+					return true;
+				}
+			}
+		}
+	}
+	misses++;
+	return false;
+}
+
+void FrameCache::Store(const Key &key, const std::string &payload)
+{
+	// Write to a temporary unique to this process and thread and rename it in, so concurrent builds never see a partial entry
+	static std::atomic<unsigned> temp_counter(0);
+	std::string path = FrameCachePath(dir, key);
+	std::ostringstream temp_name;
+#if defined(_WIN32)
+	temp_name << path << "." << GetCurrentProcessId();
+#else
+	temp_name << path << "." << getpid();
+#endif
+	temp_name << "." << std::this_thread::get_id() << "." << temp_counter++ << ".tmp";
+	std::string temp_path = temp_name.str();
+
+	{
+		std::ofstream stream(temp_path, std::ios::binary);
+		if (!stream)
+			return;
+		stream.write(FRAMECACHE_MAGIC, 4);
+		Write32(stream, key.data.size());
+		stream.write(key.data.data(), key.data.size());
+		Write32(stream, payload.size());
+		stream.write(payload.data(), payload.size());
+		if (!stream)
+		{
+			stream.close();
+			std::remove(temp_path.c_str());
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+		std::remove(temp_path.c_str());
+}
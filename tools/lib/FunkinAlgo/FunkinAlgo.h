@@ -12,19 +12,31 @@
 #include <fstream>
 #include <string>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <map>
 #include <set>
 #include <memory>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <array>
 
 #include "stb_image.h"
 
 // Constants
+static const unsigned int FRAMECACHE_VERSION = 6; // Bump whenever compiled frame output changes
+
 static const unsigned int TILE_DIM = 32;
 static const unsigned int TILE_FIT = (256 / TILE_DIM) - 1;
 
+// Memory
+// Peak resident set size of this process in bytes, 0 if unknown
+size_t PeakRSS();
+
 // Exception types
 class RuntimeError : public std::runtime_error
 {
@@ -32,19 +44,30 @@ class RuntimeError : public std::runtime_error
 		RuntimeError(std::string what_arg = "") : std::runtime_error(what_arg) {}
 };
 
+// Worker pool
+namespace Worker
+{
+	// Resolves a job count, 0 meaning one job per hardware thread
+	unsigned Jobs(unsigned jobs);
+
+	// Calls func(i) for every i < count across jobs threads
+	// The first exception thrown by any job is rethrown once all threads have stopped
+	void Run(size_t count, unsigned jobs, const std::function<void(size_t)> &func);
+}
+
 // Writes
-static void Write8(std::ostream &stream, uint8_t x)
+static inline void Write8(std::ostream &stream, uint8_t x)
 {
 	stream.put(char(x >> 0));
 }
 
-static void Write16(std::ostream &stream, uint16_t x)
+static inline void Write16(std::ostream &stream, uint16_t x)
 {
 	stream.put(char(x >> 0));
 	stream.put(char(x >> 8));
 }
 
-static void Write32(std::ostream &stream, uint32_t x)
+static inline void Write32(std::ostream &stream, uint32_t x)
 {
 	stream.put(char(x >> 0));
 	stream.put(char(x >> 8));
@@ -52,6 +75,26 @@ static void Write32(std::ostream &stream, uint32_t x)
 	stream.put(char(x >> 24));
 }
 
+// Reads
+static inline uint8_t Read8(std::istream &stream)
+{
+	return uint8_t(stream.get());
+}
+
+static inline uint16_t Read16(std::istream &stream)
+{
+	uint16_t x = Read8(stream);
+	x |= uint16_t(Read8(stream)) << 8;
+	return x;
+}
+
+static inline uint32_t Read32(std::istream &stream)
+{
+	uint32_t x = Read16(stream);
+	x |= uint32_t(Read16(stream)) << 16;
+	return x;
+}
+
 // String hashing
 namespace Hash
 {
@@ -82,6 +125,40 @@ namespace Hash
 			accumulator = (accumulator ^ (Hash)(*string++)) * FNV32_PRIME;
 		return accumulator;
 	}
+
+	// 64-bit hashes for content addressing
+	typedef uint64_t Hash64;
+
+	static const Hash64 FNV64_PRIME = 0x00000100000001B3ULL;
+	static const Hash64 FNV64_IV    = 0xCBF29CE484222325ULL;
+
+	static inline Hash64 FromBuffer64(const uint8_t *data, size_t length, Hash64 accumulator = FNV64_IV)
+	{
+		while (length-- > 0)
+			accumulator = (accumulator ^ (Hash64)(*data++)) * FNV64_PRIME;
+		return accumulator;
+	}
+
+	// SHA-256, for content that must not collide
+	class Sha256
+	{
+		public:
+			typedef std::array<uint8_t, 32> Digest;
+
+		private:
+			uint32_t state[8];
+			uint8_t block[64];
+			size_t block_size = 0;
+			uint64_t length = 0;
+
+			void Compress(const uint8_t *p);
+
+		public:
+			Sha256();
+
+			void Update(const void *data, size_t size);
+			Digest Final();
+	};
 }
 
 constexpr static inline Hash::Hash operator"" _h(const char *const literal, size_t length)
@@ -131,68 +208,35 @@ static_assert(sizeof(RGBA) == 4);
 
 struct Image
 {
+	// Pixels are malloc'd like stb_image's output, so a decode can be adopted without a copy
+	struct Free
+	{
+		void operator()(RGBA *p) const { free(p); }
+	};
+	typedef std::unique_ptr<RGBA[], Free> Pixels;
+
 	int w = 0, h = 0;
-	std::unique_ptr<RGBA[]> image;
+	Pixels image;
+
+	static Pixels Alloc(int w, int h)
+	{
+		RGBA *p = (RGBA*)malloc(sizeof(RGBA) * size_t(w) * size_t(h));
+		if (p == nullptr)
+			throw RuntimeError("Failed to allocate " + std::to_string(w) + "x" + std::to_string(h) + " image");
+		return Pixels(p);
+	}
 
 	void Decode(std::string name)
 	{
+		// Have stb_image expand to RGBA itself, so the sheet is only held once
 		int c = 0;
-		stbi_uc *image_data = stbi_load(name.c_str(), &w, &h, &c, 0);
+		stbi_uc *image_data = stbi_load(name.c_str(), &w, &h, &c, 4);
 		if (image_data == nullptr)
 			throw RuntimeError(std::string("Failed to decode ") + name);
-		image.reset(new RGBA[w * h]);
+		image.reset((RGBA*)image_data);
 		std::cout << "comp is " << c << std::endl;
-		switch (c)
-		{
-			case 0:
-				throw RuntimeError(std::string("Failed to decode (comp is 0) ") + name);
-			case 1:
-			{
-				for (int i = 0; i < w * h; i++)
-				{
-					image[i].r = image_data[i];
-					image[i].g = image_data[i];
-					image[i].b = image_data[i];
-					image[i].a = 0xFF;
-				}
-				break;
-			}
-			case 2:
-			{
-				for (int i = 0; i < w * h; i++)
-				{
-					image[i].r = image_data[i * 2 + 0];
-					image[i].g = image_data[i * 2 + 0];
-					image[i].b = image_data[i * 2 + 0];
-					image[i].a = image_data[i * 2 + 1];
-				}
-				break;
-			}
-			case 3:
-			{
-				for (int i = 0; i < w * h; i++)
-				{
-					image[i].r = image_data[i * 3 + 0];
-					image[i].g = image_data[i * 3 + 1];
-					image[i].b = image_data[i * 3 + 2];
-					image[i].a = 0xFF;
-				}
-				break;
-			}
-			case 4:
-			{
-				for (int i = 0; i < w * h; i++)
-				{
-					image[i].r = image_data[i * 4 + 0];
-					image[i].g = image_data[i * 4 + 1];
-					image[i].b = image_data[i * 4 + 2];
-					image[i].a = image_data[i * 4 + 3];
-				}
-				break;
-			}
-		}
-		// memcpy(image.get(), image_data, w * h * 4);
-		stbi_image_free(image_data);
+		if (c == 0)
+			throw RuntimeError(std::string("Failed to decode (comp is 0) ") + name);
 	}
 
 	void Flip()
@@ -214,6 +258,22 @@ struct Image
 	}
 };
 
+// Pixel kernels
+// The plain versions use SSE2 where the target has it and fall back to the scalar versions otherwise
+namespace Kernel
+{
+	// Name of the kernel set in use
+	const char *Name();
+
+	// Snaps alpha to 0x00 or 0xFF for images without semi-transparency
+	void AlphaThreshold(RGBA *p, size_t count);
+	void AlphaThresholdScalar(RGBA *p, size_t count);
+
+	// Packs 8-bit indices into 4bpp nibbles, low nibble first
+	void PackNibbles(uint8_t *out, const uint8_t *in, size_t count);
+	void PackNibblesScalar(uint8_t *out, const uint8_t *in, size_t count);
+}
+
 // Quantization
 class Quant
 {
@@ -226,6 +286,10 @@ class Quant
 	public:
 		// Quant functions
 		void Generate(const Image &in, const RGBA *fixed, int in_l, int in_t, int in_r, int in_b, bool highbpp, bool dither);
+
+		// Generates only a palette, from the merged histogram of several images
+		// Only every sample'th pixel of each image is counted
+		void Histogram(const std::vector<const Image*> &in, unsigned sample, bool highbpp);
 };
 
 // Algorithms
@@ -258,7 +322,7 @@ struct Crop
 	int cx, cy; // Image crop coordinate
 	int cw, ch; // Image crop size
 
-	uint32_t GetTPage(bool highbpp)
+	uint32_t GetTPage(bool highbpp) const
 	{
 		uint32_t tpage_x = px;
 		if (highbpp)
@@ -276,6 +340,60 @@ class Cropper
 
 	public:
 		void Compile(int tx, int ty, int w, int h);
+
+		// Splits the crops into TILE_DIM row bands tightened to their opaque texels, dropping empty ones
+		// Bands stay where they were in VRAM and only ever DMA texels the whole crop did
+		void Cover(const Quant &in, bool highbpp);
+};
+
+// VRAM allocator
+// Everything is in 16-bit VRAM units, like the tx/ty/cx/cy frame attributes
+static const int VRAM_W = 1024;
+static const int VRAM_H = 512;
+
+class VramAllocator
+{
+	public:
+		struct Rect
+		{
+			int x, y, w, h;
+		};
+
+	private:
+		// Skyline over a region, the lowest free row of each column span
+		struct Segment
+		{
+			int x, w, y;
+		};
+
+		struct Skyline
+		{
+			int x0, x1, y1;
+			std::vector<Segment> segments;
+
+			Skyline(int x0, int y0, int x1, int y1);
+			int Height(int x, int w) const;
+			void Raise(int x, int w, int y);
+		};
+
+		Skyline textures, cluts;
+		std::vector<Rect> reserved;
+		std::vector<Rect> texture_rects, clut_rects;
+
+		bool Place(Skyline &skyline, int w, int h, const std::function<bool(int, int&)> &legal, Rect &rect);
+
+	public:
+		// Textures are kept out of the framebuffer, CLUTs go in the rows below it
+		VramAllocator(int fb_w, int fb_h);
+
+		// Size of the VRAM written by a w x h texel frame placed on a page boundary
+		static void Footprint(int w, int h, bool highbpp, int &fw, int &fh);
+
+		// Places a w x h texel frame so Cropper only splits it where it has to
+		bool Texture(int w, int h, bool highbpp, int &tx, int &ty);
+		bool Clut(bool highbpp, int &cx, int &cy);
+
+		void Report(std::ostream &stream) const;
 };
 
 // Mesh
@@ -297,6 +415,28 @@ struct Poly
 };
 static_assert(sizeof(Poly) == (4 * (4 + (4 * 2))));
 
+// DMA codecs
+// The compress field of a compressed DMA is its uncompressed size, with COMPRESS_LZB set for LZB
+enum class Codec
+{
+	None,
+	Comper, // Compress::Decompress, word based and the fastest to decode
+	LZB,    // Compress::DecompressLZB, byte based so it finds the repetition in 4bpp images
+};
+
+static const uint32_t COMPRESS_LZB = 0x10000000;
+static const uint32_t COMPRESS_SIZE = 0x0FFFFFFF;
+
+// Compressed DMAs are row bands of at most STREAM_BAND_SIZE bytes, matching Compress::BAND_SIZE
+// Character::DMA decodes each band into one of two staging buffers while the GPU is sent the band before it
+static const uint32_t STREAM_BAND_SIZE = 0x2000;
+
+// Compression cost model, in CPU cycles
+// A band's decode overlaps the transfer of the band before, so uploading one costs whichever of the two is longer,
+// while a raw DMA is sent straight from RAM
+static const double DECOMPRESS_CALL_CYCLES = 500.0; // Waiting on QueueSync and setting up the transfer
+static const double DECOMPRESS_STALL_CYCLES = 2.0; // The transfer, per output byte
+
 struct DMA
 {
 	uint32_t x = 0, y = 0, w = 0, h = 0;
@@ -307,12 +447,53 @@ struct DMA
 	static DMA Image(const Quant &quant, Crop crop, bool highbpp);
 	static DMA Palette(const Quant &quant, bool highbpp);
 
+	DMA Clone() const;
+
+	// DMAs that turn VRAM holding from into VRAM holding to, only writing where to does
+	// Neither list may be compressed
+	static std::vector<DMA> Delta(const std::vector<DMA> &from, const std::vector<DMA> &to);
+
 	void AlignBCR();
 
-	void Compress();
+	// Row bands of at most STREAM_BAND_SIZE bytes, in order, which together write what the DMA does
+	// A DMA that already fits is its own only band
+	std::vector<DMA> Bands() const;
+
+	// Compressed DMAs are decoded again and compared, so a compressor bug fails the build rather than corrupting a frame
+	// Only DMAs that fit in STREAM_BAND_SIZE can be compressed
+	void Compress(Codec codec = Codec::Comper);
+
+	// Compresses with whichever codec saves the most, counting budget cycles for each byte saved against uses decompressions
+	// Returns whether it compressed
+	bool Compress(double budget, unsigned uses);
+
+	// Adds an uncompressed DMA to the list, as bands compressed with codec
+	static void Add(std::vector<DMA> &dmas, DMA dma, Codec codec);
+
+	// Compresses the bands of each DMA in the list worth it, keeping DMAs none of whose bands are whole
+	// Returns the number of bands compressed
+	static unsigned Compress(std::vector<DMA> &dmas, double budget, unsigned uses);
+
+	Codec GetCodec() const { return (compress == 0) ? Codec::None : (compress & COMPRESS_LZB) ? Codec::LZB : Codec::Comper; }
+	uint32_t RawSize() const { return (compress == 0) ? size : (compress & COMPRESS_SIZE); }
+
+	// Cycles the runtime decoder spends on a compressed DMA, counted from the instructions on its paths through
+	// Compress::Decompress or Compress::DecompressLZB, so those and this must change together
+	// Cache and bus stalls aren't counted
+	double DecodeCycles() const;
+
+	// Decodes the DMA with the host reference decoders, throwing if its data isn't a valid stream of RawSize bytes
+	std::vector<uint8_t> Decompress() const;
+
+	// Cycles each upload spends on decompressing, 0 if the DMA isn't compressed
+	double DecompressCycles() const { return (compress == 0) ? 0.0 : (DECOMPRESS_CALL_CYCLES + std::max(DECOMPRESS_STALL_CYCLES * RawSize(), DecodeCycles())); }
 	
 	static void Out(std::vector<DMA> &dmas, std::ostream &stream);
 	static size_t Size(std::vector<DMA> &dmas);
+
+	// Lossless round trip of a DMA list, used by the frame cache
+	static void Save(const std::vector<DMA> &dmas, std::ostream &stream);
+	static void Load(std::vector<DMA> &dmas, std::istream &stream);
 };
 
 class Anim
@@ -323,12 +504,48 @@ class Anim
 	public:
 		void Frame(unsigned i, unsigned length) { if (!length) length++; codes.push_back((0 << 14) | (length << 9) | i); }
 		void Back(unsigned length) { codes.push_back((1 << 14) | length); }
+		void Delta(unsigned i) { codes.push_back((2 << 14) | i); }
 		void End() { Back(1); }
 
 		static void Out(std::vector<Anim> &anims, std::ostream &stream);
 		static size_t Size(std::vector<Anim> &anims);
 };
 
+// Tile dictionary
+// Frames are cut into TILE_DIM tiles and identical tiles across every frame are stored once,
+// TILE_FIT to a texture page each way so no tile crosses a page or touches its last row or column
+class TileDictionary
+{
+	public:
+		struct Tile
+		{
+			int w, h;
+			std::vector<uint8_t> pixels; // TILE_DIM x TILE_DIM
+		};
+
+		struct Ref
+		{
+			int x, y; // Position in the frame
+			unsigned tile;
+		};
+
+		std::vector<Tile> tiles;
+
+	private:
+		std::unordered_multimap<Hash::Hash64, unsigned> tiles_find;
+
+	public:
+		// Tile dictionary functions
+		// Adds the tiles of a frame, fully transparent ones are dropped
+		std::vector<Ref> Add(const Quant &in);
+
+		// Where a tile is in the atlas, which starts on the texture page at texel tx, ty
+		Crop Cell(unsigned tile, int tx, int ty) const;
+
+		// Atlas DMAs, one per texture page
+		std::vector<DMA> Atlas(Codec compress, bool highbpp, int tx, int ty) const;
+};
+
 class Mesh
 {
 	public:
@@ -338,9 +555,13 @@ class Mesh
 
 	public:
 		// Mesh function
-		void Compile(const Quant &in, bool compress, bool highbpp, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty);
+		void Compile(const Quant &in, Codec compress, bool highbpp, bool coverage, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty);
+		// Only makes the polys, the atlas is shared by every frame
+		void CompileTiled(const TileDictionary &dictionary, const std::vector<TileDictionary::Ref> &refs, bool highbpp, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty);
 		void Out(std::ostream &stream);
+		void In(std::istream &stream);
 		size_t Size();
+		size_t Fill() const; // Texels drawn
 };
 
 // Sprites
@@ -361,7 +582,54 @@ class Sprites
 
 	public:
 		// Sprites functions
-		void Compile(const Quant &in, bool compress, bool highbpp, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty);
+		void Compile(const Quant &in, Codec compress, bool highbpp, bool coverage, int semi, int ax, int ay, int tx, int ty, int clutx, int cluty);
 		void Out(std::ostream &stream);
+		void In(std::istream &stream);
 		size_t Size();
+		size_t Fill() const; // Texels drawn
+};
+
+// Content-addressed cache of compiled frames
+class FrameCache
+{
+	public:
+		// Cache key, built from everything that affects a compiled frame
+		class Key
+		{
+			public:
+				std::string data;
+
+			public:
+				Key() { Add(FRAMECACHE_VERSION); }
+
+				void Add(const void *p, size_t size) { data.append((const char*)p, size); }
+				template <typename T>
+				void Add(const T &x) { static_assert(std::is_trivially_copyable<T>::value); Add(&x, sizeof(T)); }
+				void Add(const std::string &x) { Add(uint32_t(x.size())); data.append(x); }
+
+				// Size and SHA-256 of a source rectangle, which keys carry in place of its pixels
+				struct Pixels
+				{
+					int w, h;
+					Hash::Sha256::Digest digest;
+				};
+				static Pixels HashPixels(const Image &image, int in_l, int in_t, int in_r, int in_b);
+
+				Hash::Hash64 Hash() const { return Hash::FromBuffer64((const uint8_t*)data.data(), data.size()); }
+		};
+
+	private:
+		// Cache directory
+		std::string dir;
+
+	public:
+		// Statistics
+		std::atomic<unsigned> hits{0}, misses{0};
+
+	public:
+		// Frame cache functions
+		FrameCache(std::string dir);
+
+		bool Load(const Key &key, std::string &payload);
+		void Store(const Key &key, const std::string &payload);
 };
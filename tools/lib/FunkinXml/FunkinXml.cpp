@@ -0,0 +1,961 @@
+/*
+	[ FunkinXml ]
+	Copyright Regan "CKDEV" Green 2023-2025
+
+	- FunkinXml.cpp -
+	Funkin character and sprite xml compiler
+*/
+
+#include "FunkinXml.h"
+
+#include <sstream>
+#include <filesystem>
+#include <cmath>
+
+// Common functions
+void OpenDocument(tinyxml2::XMLDocument &doc, std::string name)
+{
+	if (doc.LoadFile(name.c_str()) != tinyxml2::XML_SUCCESS)
+	{
+		if (doc.ErrorID() == tinyxml2::XML_ERROR_FILE_NOT_FOUND ||
+			doc.ErrorID() == tinyxml2::XML_ERROR_FILE_COULD_NOT_BE_OPENED ||
+			doc.ErrorID() == tinyxml2::XML_ERROR_FILE_READ_ERROR)
+			throw RuntimeError(std::string("Failed to open") + name);
+		else
+			throw RuntimeError(std::string(doc.ErrorName()) + " on line " + std::to_string(doc.ErrorLineNum()));
+	}
+}
+
+std::string GetDirectory(std::string name)
+{
+	size_t cut = name.find_last_of("/\\");
+	if (cut != std::string::npos)
+		return name.substr(0, cut + 1);
+	return "";
+}
+
+// Sprite sheet xml
+SpriteSheetXml::SpriteSheetXml(std::string name, bool decode)
+{
+	// Open document
+	OpenDocument(doc, name);
+
+	// Get sheet element
+	tinyxml2::XMLElement *doc_sheet = doc.FirstChildElement("TextureAtlas");
+	if (doc_sheet == nullptr)
+		throw RuntimeError("Cannot find TextureAtlas element");
+	
+	// Read sheet information
+	const char *image_name = doc_sheet->Attribute("imagePath");
+	if (image_name == nullptr)
+		throw RuntimeError("Cannot find imagePath attribute");
+	
+	// Decode image
+	if (decode)
+		image.Decode(GetDirectory(name) + image_name);
+
+	// Read subtextures
+	for (
+		tinyxml2::XMLElement *doc_subtexture = doc_sheet->FirstChildElement("SubTexture");
+		doc_subtexture != nullptr;
+		doc_subtexture = doc_subtexture->NextSiblingElement("SubTexture")
+	)
+	{
+		// Read subtexture attributes
+		const char *subtexture_name = doc_subtexture->Attribute("name");
+		if (subtexture_name == nullptr)
+			throw RuntimeError("Subtexture has no name");
+
+		SubTexture subtexture;
+		subtexture.x = doc_subtexture->IntAttribute("x");
+		subtexture.y = doc_subtexture->IntAttribute("y");
+		subtexture.width = doc_subtexture->IntAttribute("width");
+		subtexture.height = doc_subtexture->IntAttribute("height");
+		subtexture.frameX = doc_subtexture->IntAttribute("frameX", 0);
+		subtexture.frameY = doc_subtexture->IntAttribute("frameY", 0);
+		subtexture.frameWidth = doc_subtexture->IntAttribute("frameWidth", subtexture.width);
+		subtexture.frameHeight = doc_subtexture->IntAttribute("frameHeight", subtexture.height);
+
+		subtextures.emplace(std::make_pair(std::string(subtexture_name), subtexture));
+	}
+}
+
+// Sheet cache
+std::string SheetCache::Key(std::string name)
+{
+	return std::filesystem::path(name).lexically_normal().generic_string();
+}
+
+void SheetCache::Expect(std::string name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	uses[Key(name)]++;
+}
+
+std::shared_ptr<SpriteSheetXml> SheetCache::Open(std::string name)
+{
+	std::string key = Key(name);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<SpriteSheetXml> sheet;
+
+	auto find = sheets.find(key);
+	if (find != sheets.end())
+	{
+		hits++;
+		sheet = find->second;
+	}
+	else
+	{
+		misses++;
+		sheet = std::make_shared<SpriteSheetXml>(name);
+		sheets.emplace(key, sheet);
+	}
+
+	// Drop our reference after the last expected use
+	auto uses_find = uses.find(key);
+	if (uses_find != uses.end() && --uses_find->second == 0)
+	{
+		uses.erase(uses_find);
+		sheets.erase(key);
+	}
+	return sheet;
+}
+
+std::string GetSheetName(std::string name)
+{
+	tinyxml2::XMLDocument doc;
+	OpenDocument(doc, name);
+
+	tinyxml2::XMLElement *doc_chr = doc.FirstChildElement();
+	const char *sheet_name = (doc_chr != nullptr) ? doc_chr->Attribute("sheet") : nullptr;
+	if (sheet_name == nullptr)
+		throw RuntimeError("Cannot find sheet attribute");
+	return GetDirectory(name) + sheet_name;
+}
+
+// Layout measure
+// Same size Algo::Generate gives
+static void ScaledSize(const SubTexture &subtex, float scale, int &w, int &h)
+{
+	if (scale == 1.0f)
+	{
+		w = subtex.width;
+		h = subtex.height;
+	}
+	else
+	{
+		w = std::ceil(subtex.width * scale);
+		h = std::ceil(subtex.height * scale);
+	}
+}
+
+XmlLayout MeasureXml(std::string name)
+{
+	tinyxml2::XMLDocument doc;
+	OpenDocument(doc, name);
+
+	tinyxml2::XMLElement *doc_chr = doc.FirstChildElement();
+	const char *sheet_name = (doc_chr != nullptr) ? doc_chr->Attribute("sheet") : nullptr;
+	if (sheet_name == nullptr)
+		throw RuntimeError("Cannot find sheet attribute");
+
+	XmlLayout layout;
+	layout.highbpp = doc_chr->IntAttribute("highbpp", 0) != 0;
+	layout.singleclut = doc_chr->IntAttribute("singleclut", 0) != 0;
+	layout.tiled = doc_chr->IntAttribute("tiled", 0) != 0;
+	float scale = doc_chr->FloatAttribute("scale", 1.0f);
+
+	SpriteSheetXml sheet(GetDirectory(name) + sheet_name, false);
+
+	for (
+		tinyxml2::XMLElement *doc_frame = doc_chr->FirstChildElement("frame");
+		doc_frame != nullptr;
+		doc_frame = doc_frame->NextSiblingElement("frame")
+	)
+	{
+		const char *source_name = doc_frame->Attribute("source");
+		if (source_name == nullptr)
+			throw RuntimeError("Cannot find source attribute for frame");
+
+		XmlLayout::Frame frame;
+		if (source_name[0] != '\0')
+		{
+			auto subtex_find = sheet.subtextures.find(std::string(source_name));
+			if (subtex_find == sheet.subtextures.end())
+				throw RuntimeError(std::string(source_name) + " SubTexture not found");
+			ScaledSize(subtex_find->second, scale, frame.w, frame.h);
+		}
+		layout.frames.push_back(frame);
+	}
+	return layout;
+}
+
+// Frame type traits
+template <typename T>
+struct FrameTraits;
+
+template <>
+struct FrameTraits<Mesh>
+{
+	static constexpr const char *element = "chr";
+	static constexpr const char *stage = "mesh";
+};
+
+template <>
+struct FrameTraits<Sprites>
+{
+	static constexpr const char *element = "spr";
+	static constexpr const char *stage = "sprite";
+};
+
+// Mesh and DMA records of an output file
+// Frames that compile to identical bytes, such as held poses repeated under different names, share one record
+class RecordTable
+{
+	private:
+		std::unordered_map<std::string, uint32_t> offsets;
+		std::vector<const std::string*> records;
+		uint32_t poff;
+
+	public:
+		size_t saved = 0;
+
+	public:
+		RecordTable(uint32_t poff) : poff(poff) {}
+
+		template <typename F>
+		uint32_t Add(F out)
+		{
+			std::ostringstream stream;
+			out(stream);
+
+			auto record = offsets.emplace(stream.str(), poff);
+			if (record.second)
+			{
+				records.push_back(&record.first->first);
+				poff += record.first->first.size();
+			}
+			else
+			{
+				saved += record.first->first.size();
+			}
+			return record.first->second;
+		}
+
+		void Out(std::ostream &stream)
+		{
+			for (auto &i : records)
+				stream.write(i->data(), i->size());
+		}
+};
+
+// Character process xml
+template <typename T>
+CharacterXml<T>::CharacterXml(std::string name, const char *chr_name, const char *msh_name, const char *dma_name, const Options &options, const Placement *placement)
+{
+	// Open document
+	OpenDocument(doc, name);
+
+	// Get character element
+	tinyxml2::XMLElement *doc_chr = doc.FirstChildElement(FrameTraits<T>::element);
+	if (doc_chr == nullptr)
+		throw RuntimeError(std::string("Cannot find ") + FrameTraits<T>::element + " element");
+
+	// Read character information
+	const char *sheet_name = doc_chr->Attribute("sheet");
+	if (sheet_name == nullptr)
+		throw RuntimeError("Cannot find sheet attribute");
+
+	// compress="1" is Comper and compress="lzb" is LZB
+	// compress="auto" compiles raw, then picks each DMA's codec, if any, once the animations are known
+	const char *compress_attr = doc_chr->Attribute("compress");
+	bool compress_auto = compress_attr != nullptr && std::string(compress_attr) == "auto";
+	Codec compress = Codec::None;
+	if (options.uncompressed)
+		compress_auto = false;
+	else if (compress_attr != nullptr && std::string(compress_attr) == "lzb")
+		compress = Codec::LZB;
+	else if (!compress_auto && doc_chr->IntAttribute("compress", 0) != 0)
+		compress = Codec::Comper;
+	bool highbpp = doc_chr->IntAttribute("highbpp", 0) != 0;
+	bool dither = doc_chr->IntAttribute("dither", 0) != 0;
+	int semi = doc_chr->IntAttribute("semi", -1);
+	float scale = doc_chr->FloatAttribute("scale", 1.0f);
+	bool singleclut = doc_chr->IntAttribute("singleclut", 0) != 0;
+	bool tiled = doc_chr->IntAttribute("tiled", 0) != 0;
+	bool coverage = doc_chr->IntAttribute("coverage", 0) != 0;
+
+	// Tiles are only identical between frames if they share a palette
+	if (tiled && !std::is_same<T, Mesh>::value)
+		throw RuntimeError("tiled is only supported for characters");
+	if (tiled && !singleclut)
+		throw RuntimeError("tiled needs singleclut");
+	
+	// Open sprite sheet
+	std::shared_ptr<SpriteSheetXml> sheet;
+	if (options.sheets != nullptr)
+		sheet = options.sheets->Open(GetDirectory(name) + sheet_name);
+	else
+		sheet = std::make_shared<SpriteSheetXml>(GetDirectory(name) + sheet_name);
+
+	// Open frame cache
+	std::unique_ptr<FrameCache> cache;
+	if (!options.cache_dir.empty())
+		cache.reset(new FrameCache(options.cache_dir));
+
+	// Read frames
+	struct Frame
+	{
+		std::string source_name;
+		SubTexture subtex;
+		bool flip;
+		int ax, ay, tx, ty, cx, cy;
+	};
+	std::vector<Frame> sources;
+	std::unordered_map<std::string, unsigned> mesh_iv;
+	
+	std::vector<Anim> anims;
+
+	for (
+		tinyxml2::XMLElement *doc_frame = doc_chr->FirstChildElement("frame");
+		doc_frame != nullptr;
+		doc_frame = doc_frame->NextSiblingElement("frame")
+	)
+	{
+		const char *source_name = doc_frame->Attribute("source");
+		if (source_name == nullptr)
+			throw RuntimeError("Cannot find source attribute for frame");
+
+		Frame frame = {};
+		frame.source_name = source_name;
+
+		if (source_name[0] != '\0')
+		{
+			auto subtex_find = sheet->subtextures.find(std::string(source_name));
+			if (subtex_find == sheet->subtextures.end())
+				throw RuntimeError(std::string(source_name) + " SubTexture not found");
+			SubTexture subtex = subtex_find->second;
+
+			frame.subtex = subtex;
+			frame.flip = doc_frame->IntAttribute("flip", 0) != 0;
+			frame.ax = doc_frame->IntAttribute("ax", subtex.frameWidth / 2) + subtex.frameX;
+			frame.ay = doc_frame->IntAttribute("ay", subtex.frameHeight / 2) + subtex.frameY;
+			frame.tx = doc_frame->IntAttribute("tx", 0);
+			frame.ty = doc_frame->IntAttribute("ty", 0);
+			frame.cx = doc_frame->IntAttribute("cx", 0);
+			frame.cy = doc_frame->IntAttribute("cy", 0);
+
+			if (placement != nullptr)
+			{
+				if (sources.size() >= placement->frames.size())
+					throw RuntimeError("No placement for frame " + frame.source_name);
+				const Placement::Frame &place = placement->frames[sources.size()];
+				frame.tx = place.tx;
+				frame.ty = place.ty;
+				frame.cx = place.cx;
+				frame.cy = place.cy;
+			}
+		}
+
+		mesh_iv.emplace(std::make_pair(frame.source_name, unsigned(sources.size())));
+		sources.push_back(std::move(frame));
+	}
+
+	// Compile frames
+	// Each job writes only its own slot, so the output order matches the serial order
+	struct FrameTime
+	{
+		Clock::duration algo{}, quant{}, compile{};
+	};
+	frames.resize(sources.size());
+	std::vector<FrameTime> times(sources.size());
+
+	// Tiled frames are only quantized by the frame jobs, and made into meshes once every tile is known
+	struct TiledFrame
+	{
+		Quant quant;
+		int ax, ay;
+	};
+	std::vector<TiledFrame> tiled_frames(tiled ? sources.size() : 0);
+
+	Clock::time_point wall_start = Clock::now();
+
+	// Get fixed palette
+	// Built from the merged histogram of the scaled frames that are actually referenced,
+	// rather than the whole sheet and its unused space
+	// The quantizer must outlive the frame jobs that read its palette
+	Quant fixed_quant;
+	RGBA *fixed = nullptr;
+	std::vector<std::unique_ptr<Algo>> algos(sources.size());
+
+	// Hash each frame's source pixels once, the palette and frame keys share them
+	std::vector<FrameCache::Key::Pixels> pixels(cache != nullptr ? sources.size() : 0);
+	if (cache != nullptr)
+	{
+		Worker::Run(sources.size(), options.jobs, [&](size_t i)
+		{
+			const Frame &frame = sources[i];
+			if (frame.source_name.empty())
+				return;
+			const SubTexture &subtex = frame.subtex;
+			pixels[i] = FrameCache::Key::HashPixels(sheet->image, subtex.x, subtex.y, subtex.x + subtex.width, subtex.y + subtex.height);
+		});
+	}
+
+	if (singleclut)
+	{
+		unsigned sample = doc_chr->UnsignedAttribute("sample", 1);
+
+		// The palette is cached like a frame, keyed by every referenced frame
+		FrameCache::Key key;
+		std::string payload;
+		if (cache != nullptr)
+		{
+			key.Add(std::string("histogram"));
+			for (size_t i = 0; i < sources.size(); i++)
+			{
+				if (sources[i].source_name.empty())
+					continue;
+				key.Add(pixels[i]);
+				key.Add(sources[i].ax); key.Add(sources[i].ay);
+			}
+			key.Add(scale);
+			key.Add(semi);
+			key.Add(sample);
+			key.Add(highbpp);
+		}
+
+		if (cache != nullptr && cache->Load(key, payload) && payload.size() == sizeof(fixed_quant.palette))
+		{
+			memcpy(fixed_quant.palette, payload.data(), payload.size());
+		}
+		else
+		{
+			// Scale the frames up front, the frame jobs reuse them
+			Worker::Run(sources.size(), options.jobs, [&](size_t i)
+			{
+				const Frame &frame = sources[i];
+				if (frame.source_name.empty())
+					return;
+
+				const SubTexture &subtex = frame.subtex;
+				Clock::time_point t0 = Clock::now();
+				algos[i].reset(new Algo);
+				algos[i]->Generate(sheet->image, semi >= 0, subtex.x, subtex.y, subtex.x + subtex.width, subtex.y + subtex.height, frame.ax, frame.ay, scale);
+				times[i].algo = Clock::now() - t0;
+			});
+
+			std::vector<const Image*> images;
+			for (auto &i : algos)
+				if (i != nullptr)
+					images.push_back(&i->image);
+			fixed_quant.Histogram(images, sample, highbpp);
+
+			if (cache != nullptr)
+				cache->Store(key, std::string((const char*)fixed_quant.palette, sizeof(fixed_quant.palette)));
+		}
+		fixed = fixed_quant.palette;
+	}
+
+	Worker::Run(sources.size(), options.jobs, [&](size_t i)
+	{
+		const Frame &frame = sources[i];
+		if (frame.source_name.empty())
+			return;
+
+		const SubTexture &subtex = frame.subtex;
+		FrameTime &time = times[i];
+
+		// Look up frame cache
+		FrameCache::Key key;
+		if (cache != nullptr)
+		{
+			key.Add(std::string(tiled ? "tiles" : FrameTraits<T>::element));
+			key.Add(pixels[i]);
+			key.Add(scale);
+			key.Add(frame.flip);
+			key.Add(frame.ax); key.Add(frame.ay);
+			key.Add(frame.tx); key.Add(frame.ty);
+			key.Add(frame.cx); key.Add(frame.cy);
+			key.Add(compress);
+			key.Add(highbpp);
+			key.Add(coverage);
+			key.Add(dither);
+			key.Add(semi);
+			key.Add(fixed != nullptr);
+			if (fixed != nullptr)
+				key.Add(fixed, sizeof(RGBA) * 256);
+
+			std::string payload;
+			if (cache->Load(key, payload))
+			{
+				std::istringstream stream(payload);
+				if (tiled)
+				{
+					TiledFrame &tiled_frame = tiled_frames[i];
+					tiled_frame.ax = int32_t(Read32(stream));
+					tiled_frame.ay = int32_t(Read32(stream));
+					tiled_frame.quant.w = Read32(stream);
+					tiled_frame.quant.h = Read32(stream);
+					tiled_frame.quant.image.reset(new uint8_t[tiled_frame.quant.w * tiled_frame.quant.h]);
+					stream.read((char*)tiled_frame.quant.image.get(), tiled_frame.quant.w * tiled_frame.quant.h);
+					memcpy(tiled_frame.quant.palette, fixed, sizeof(tiled_frame.quant.palette));
+				}
+				else
+				{
+					frames[i].In(stream);
+					DMA::Load(frames[i].dmas, stream);
+				}
+				return;
+			}
+		}
+
+		Clock::time_point t0 = Clock::now();
+		std::unique_ptr<Algo> algo = std::move(algos[i]);
+		if (algo == nullptr)
+		{
+			algo.reset(new Algo);
+			algo->Generate(sheet->image, semi >= 0, subtex.x, subtex.y, subtex.x + subtex.width, subtex.y + subtex.height, frame.ax, frame.ay, scale);
+		}
+		if (frame.flip)
+			algo->Flip();
+
+		int ax = algo->anchor_x;
+		int ay = algo->anchor_y;
+
+		Clock::time_point t1 = Clock::now();
+		Quant quant;
+		quant.Generate(algo->image, fixed, 0, 0, algo->image.w, algo->image.h, highbpp, dither);
+		algo.reset();
+		
+		Clock::time_point t2 = Clock::now();
+		if (tiled)
+		{
+			// Store in frame cache
+			if (cache != nullptr)
+			{
+				std::ostringstream stream;
+				Write32(stream, ax);
+				Write32(stream, ay);
+				Write32(stream, quant.w);
+				Write32(stream, quant.h);
+				stream.write((const char*)quant.image.get(), quant.w * quant.h);
+				cache->Store(key, stream.str());
+			}
+
+			tiled_frames[i].ax = ax;
+			tiled_frames[i].ay = ay;
+			tiled_frames[i].quant = std::move(quant);
+
+			time.algo += t1 - t0;
+			time.quant = t2 - t1;
+			return;
+		}
+		frames[i].Compile(quant, compress, highbpp, coverage, semi, ax, ay, frame.tx, frame.ty, frame.cx, frame.cy);
+		Clock::time_point t3 = Clock::now();
+
+		// Store in frame cache
+		if (cache != nullptr)
+		{
+			std::ostringstream stream;
+			frames[i].Out(stream);
+			DMA::Save(frames[i].dmas, stream);
+			cache->Store(key, stream.str());
+		}
+
+		time.algo += t1 - t0;
+		time.quant = t2 - t1;
+		time.compile = t3 - t2;
+	});
+
+	// Make tiled meshes
+	// Every frame uploads the same atlas, so they all share one DMA record and it's only uploaded once
+	if constexpr (std::is_same<T, Mesh>::value)
+	{
+		if (tiled)
+		{
+			Clock::time_point t0 = Clock::now();
+
+			const Frame *first = nullptr;
+			for (auto &i : sources)
+			{
+				if (!i.source_name.empty())
+				{
+					first = &i;
+					break;
+				}
+			}
+
+			if (first != nullptr)
+			{
+				TileDictionary dictionary;
+				std::vector<std::vector<TileDictionary::Ref>> refs(sources.size());
+				size_t total = 0;
+				for (size_t i = 0; i < sources.size(); i++)
+				{
+					if (sources[i].source_name.empty())
+						continue;
+					refs[i] = dictionary.Add(tiled_frames[i].quant);
+					total += refs[i].size();
+				}
+
+				std::vector<DMA> atlas = dictionary.Atlas(compress, highbpp, first->tx, first->ty);
+				DMA palette = std::move(DMA::Palette(fixed_quant, highbpp));
+				palette.x = first->cx;
+				palette.y = first->cy;
+
+				for (size_t i = 0; i < sources.size(); i++)
+				{
+					if (!sources[i].source_name.empty())
+						frames[i].CompileTiled(dictionary, refs[i], highbpp, semi, tiled_frames[i].ax, tiled_frames[i].ay, first->tx, first->ty, first->cx, first->cy);
+					for (auto &j : atlas)
+						frames[i].dmas.push_back(j.Clone());
+					frames[i].dmas.push_back(palette.Clone());
+				}
+
+				std::cout << name << ": " << total << " tiles, " << dictionary.tiles.size() << " unique in " << atlas.size() << " atlas pages" << std::endl;
+			}
+			tiled_frames.clear();
+
+			times[0].compile += Clock::now() - t0;
+		}
+	}
+	Clock::duration wall = Clock::now() - wall_start;
+
+	// Report timing
+	{
+		FrameTime total;
+		for (auto &i : times)
+		{
+			total.algo += i.algo;
+			total.quant += i.quant;
+			total.compile += i.compile;
+		}
+		double cpu = Millis(total.algo + total.quant + total.compile);
+		std::cout << name << ": " << sources.size() << " frames on " << Worker::Jobs(options.jobs) << " jobs in " << Millis(wall) << "ms"
+			<< " (algo " << Millis(total.algo) << "ms, quant " << Millis(total.quant) << "ms, " << FrameTraits<T>::stage << " " << Millis(total.compile) << "ms"
+			<< ", " << (Millis(wall) > 0.0 ? (cpu / Millis(wall)) : 1.0) << "x)";
+		if (cache != nullptr)
+			std::cout << ", cache " << cache->hits << " hits, " << cache->misses << " misses";
+		std::cout << std::endl;
+	}
+
+	// Report coverage savings against the uncovered crops
+	if (coverage && !tiled)
+	{
+		size_t fill_full = 0, fill = 0, upload_full = 0, upload = 0;
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			const Frame &frame = sources[i];
+			if (frame.source_name.empty())
+				continue;
+
+			int w, h;
+			ScaledSize(frame.subtex, scale, w, h);
+
+			Cropper cropper;
+			cropper.Compile(frame.tx << (highbpp ? 1 : 2), frame.ty, w, h);
+			for (auto &j : cropper.crops)
+			{
+				int vram_w = highbpp ? ((j.cw + 1) >> 1) : ((j.cw + 3) >> 2);
+				vram_w += vram_w & 1;
+				fill_full += j.cw * j.ch;
+				upload_full += (vram_w * 2) * j.ch;
+			}
+
+			fill += frames[i].Fill();
+			for (size_t j = 0; (j + 1) < frames[i].dmas.size(); j++)
+				upload += (frames[i].dmas[j].w * 2) * frames[i].dmas[j].h;
+		}
+		std::cout << name << ": coverage fill " << fill_full << " -> " << fill << " texels, upload " << upload_full << " -> " << upload << " bytes" << std::endl;
+	}
+
+	// Read animations
+	struct AnimCode
+	{
+		enum { Frame, Back, End } op;
+		unsigned frame, length;
+	};
+	std::vector<std::vector<AnimCode>> anim_codes;
+
+	for (
+		tinyxml2::XMLElement *doc_anim = doc_chr->FirstChildElement("anim");
+		doc_anim != nullptr;
+		doc_anim = doc_anim->NextSiblingElement("anim")
+	)
+	{
+		// Read animation
+		std::vector<AnimCode> codes;
+		for (
+			tinyxml2::XMLElement *anim_element = doc_anim->FirstChildElement();
+			anim_element != nullptr;
+			anim_element = anim_element->NextSiblingElement()
+		)
+		{
+			std::string element_name(anim_element->Name());
+			if (element_name == "frame")
+			{
+				const char *source_name = anim_element->Attribute("source");
+				if (source_name == nullptr)
+					throw RuntimeError("Cannot find source attribute for anim frame");
+				auto frame_source_find = mesh_iv.find(std::string(source_name));
+				if (frame_source_find == mesh_iv.end())
+					throw RuntimeError("Failed to find source for animation " + std::string(source_name));
+				codes.push_back(AnimCode{ AnimCode::Frame, frame_source_find->second, unsigned(anim_element->IntAttribute("length")) });
+			}
+			else if (element_name == "back")
+			{
+				codes.push_back(AnimCode{ AnimCode::Back, 0, unsigned(anim_element->IntAttribute("length")) });
+			}
+			else if (element_name == "end")
+			{
+				codes.push_back(AnimCode{ AnimCode::End, 0, 0 });
+			}
+			else
+			{
+				throw RuntimeError("Bad animation element " + element_name);
+			}
+		}
+		anim_codes.push_back(std::move(codes));
+	}
+
+	// Make delta uploads between consecutive frames of an animation
+	// Only streamed characters upload their frames one at a time over each other
+	// Each delta is an extra entry after the frames in the pointer table, holding its base frame and DMA
+	std::map<std::pair<unsigned, unsigned>, unsigned> delta_find;
+	std::vector<std::pair<unsigned, unsigned>> delta_pairs;
+	std::vector<std::vector<DMA>> deltas;
+	std::vector<unsigned> delta_bases;
+
+	if (std::is_same<T, Mesh>::value && chr_name != nullptr && compress == Codec::None && !tiled)
+	{
+		for (auto &i : anim_codes)
+		{
+			const AnimCode *last = nullptr;
+			for (auto &j : i)
+			{
+				if (j.op == AnimCode::Frame && last != nullptr && last->frame != j.frame)
+				{
+					std::pair<unsigned, unsigned> pair(last->frame, j.frame);
+					if (delta_find.emplace(pair, 0).second)
+						delta_pairs.push_back(pair);
+				}
+				last = (j.op == AnimCode::Frame) ? &j : nullptr;
+			}
+		}
+
+		// Only keep deltas smaller than the frame they replace
+		std::vector<std::vector<DMA>> delta_dmas(delta_pairs.size());
+		Worker::Run(delta_pairs.size(), options.jobs, [&](size_t i)
+		{
+			delta_dmas[i] = DMA::Delta(frames[delta_pairs[i].first].dmas, frames[delta_pairs[i].second].dmas);
+		});
+
+		size_t delta_size = 0, full_size = 0;
+		for (size_t i = 0; i < delta_pairs.size(); i++)
+		{
+			size_t size = DMA::Size(delta_dmas[i]);
+			size_t full = DMA::Size(frames[delta_pairs[i].second].dmas);
+			if (size >= full)
+			{
+				delta_find[delta_pairs[i]] = ~0U;
+				continue;
+			}
+			delta_find[delta_pairs[i]] = frames.size() + deltas.size();
+			deltas.push_back(std::move(delta_dmas[i]));
+			delta_bases.push_back(delta_pairs[i].first);
+			delta_size += size;
+			full_size += full;
+		}
+		if (frames.size() + deltas.size() > 0x4000)
+			throw RuntimeError("Too many frames and deltas");
+
+		if (!deltas.empty())
+			std::cout << name << ": " << deltas.size() << " of " << delta_pairs.size() << " frame steps delta uploaded, " << full_size << " -> " << delta_size << " bytes" << std::endl;
+	}
+
+	// Make animation codes
+	// Back lengths count the xml's codes, so they're remapped past the delta codes
+	for (auto &i : anim_codes)
+	{
+		Anim anim;
+		std::vector<unsigned> code_at;
+		const AnimCode *last = nullptr;
+		for (auto &j : i)
+		{
+			switch (j.op)
+			{
+				case AnimCode::Frame:
+				{
+					if (last != nullptr && last->frame != j.frame)
+					{
+						auto delta = delta_find.find(std::make_pair(last->frame, j.frame));
+						if (delta != delta_find.end() && delta->second != ~0U)
+							anim.Delta(delta->second);
+					}
+					code_at.push_back(anim.codes.size());
+					anim.Frame(j.frame, j.length);
+					last = &j;
+					break;
+				}
+				case AnimCode::Back:
+				{
+					if (j.length > code_at.size())
+						throw RuntimeError("Animation back goes before its start");
+					unsigned target = code_at[code_at.size() - j.length];
+					code_at.push_back(anim.codes.size());
+					anim.Back(anim.codes.size() - target);
+					last = nullptr;
+					break;
+				}
+				case AnimCode::End:
+				{
+					code_at.push_back(anim.codes.size());
+					anim.End();
+					last = nullptr;
+					break;
+				}
+			}
+		}
+		anims.push_back(std::move(anim));
+	}
+
+	// Compress DMAs worth it
+	// Streamed characters decompress a frame every time it's shown, so frames used by more animation codes are hotter
+	// Everything else is uploaded once when loaded
+	if (compress_auto)
+	{
+		std::vector<unsigned> uses(frames.size() + deltas.size(), 1);
+		if (chr_name != nullptr)
+		{
+			std::fill(uses.begin(), uses.end(), 0);
+			for (auto &i : anims)
+			{
+				for (auto &j : i.codes)
+				{
+					if ((j >> 14) == 0)
+						uses[j & 0x1FF]++;
+					else if ((j >> 14) == 2)
+						uses[j & 0x3FFF]++;
+				}
+			}
+		}
+
+		std::vector<std::vector<DMA>*> lists;
+		for (auto &i : frames)
+			lists.push_back(&i.dmas);
+		for (auto &i : deltas)
+			lists.push_back(&i);
+
+		std::vector<unsigned> compressed(lists.size());
+		Worker::Run(lists.size(), options.jobs, [&](size_t i)
+		{
+			compressed[i] = DMA::Compress(*lists[i], options.compress_budget, std::max(uses[i], 1U));
+		});
+
+		size_t dmas = 0, dmas_compressed = 0, dmas_lzb = 0, raw_size = 0, size = 0;
+		double cycles = 0.0;
+		for (size_t i = 0; i < lists.size(); i++)
+		{
+			for (auto &j : *lists[i])
+			{
+				dmas++;
+				raw_size += j.RawSize();
+				size += j.size;
+				cycles += uses[i] * j.DecompressCycles();
+				if (j.GetCodec() == Codec::LZB)
+					dmas_lzb++;
+			}
+			dmas_compressed += compressed[i];
+		}
+		std::cout << name << ": compressed " << dmas_compressed << " of " << dmas << " DMAs (" << dmas_lzb << " LZB) at budget " << options.compress_budget << ", " << raw_size << " -> " << size << " bytes, ~" << size_t(cycles) << " decompression cycles" << std::endl;
+	}
+
+	// Hack for alignment
+	if (anims.size() && (Anim::Size(anims) & 3))
+		anims[0].End();
+
+	// Write out character or sprite
+	size_t saved = 0;
+	if (chr_name != nullptr)
+	{
+		// Open .chr or .spr file
+		std::ofstream stream(chr_name, std::ios::binary);
+		if (!stream)
+			throw RuntimeError(std::string("Failed to open") + chr_name);
+
+		// Point to msh data
+		Write32(stream, 4 + Anim::Size(anims));
+
+		// Write anim data
+		Anim::Out(anims, stream);
+
+		// Write msh pointers
+		RecordTable records((4 * 2) * (frames.size() + deltas.size()));
+		for (auto &i : frames)
+		{
+			Write32(stream, records.Add([&](std::ostream &out) { i.Out(out); }));
+			Write32(stream, records.Add([&](std::ostream &out) { DMA::Out(i.dmas, out); }));
+		}
+
+		// Write delta pointers, with their base frame in place of a mesh
+		for (size_t i = 0; i < deltas.size(); i++)
+		{
+			Write32(stream, delta_bases[i]);
+			Write32(stream, records.Add([&](std::ostream &out) { DMA::Out(deltas[i], out); }));
+		}
+
+		// Write msh and dma data
+		records.Out(stream);
+		saved += records.saved;
+	}
+	else if (msh_name != nullptr)
+	{
+		{
+			// Open .msh or .spr file
+			std::ofstream stream(msh_name, std::ios::binary);
+			if (!stream)
+				throw RuntimeError(std::string("Failed to open") + msh_name);
+
+			// Point to msh pointers
+			Write32(stream, 4 + Anim::Size(anims));
+
+			// Write anim data
+			Anim::Out(anims, stream);
+
+			// Write msh pointers
+			RecordTable records((4 * 2) * frames.size());
+			for (auto &i : frames)
+			{
+				Write32(stream, records.Add([&](std::ostream &out) { i.Out(out); }));
+				Write32(stream, 0);
+			}
+
+			// Write msh data
+			records.Out(stream);
+			saved += records.saved;
+		}
+		{
+			// Open .dma file
+			std::ofstream stream(dma_name, std::ios::binary);
+			if (!stream)
+				throw RuntimeError(std::string("Failed to open") + msh_name);
+
+			// Write dma pointers
+			RecordTable records(4 * frames.size());
+			for (auto &i : frames)
+				Write32(stream, records.Add([&](std::ostream &out) { DMA::Out(i.dmas, out); }));
+
+			// Write dma data
+			records.Out(stream);
+			saved += records.saved;
+		}
+	}
+
+	if (saved != 0)
+		std::cout << name << ": shared identical frames, " << saved << " bytes saved" << std::endl;
+}
+
+template class CharacterXml<Mesh>;
+template class CharacterXml<Sprites>;
@@ -0,0 +1,136 @@
+/*
+	[ FunkinXml ]
+	Copyright Regan "CKDEV" Green 2023-2025
+
+	- FunkinXml.h -
+	Funkin character and sprite xml compiler
+*/
+
+#pragma once
+
+#include <FunkinAlgo.h>
+#include <tinyxml2.h>
+
+#include <chrono>
+#include <mutex>
+
+// Common functions
+void OpenDocument(tinyxml2::XMLDocument &doc, std::string name);
+std::string GetDirectory(std::string name);
+
+// Timing
+typedef std::chrono::steady_clock Clock;
+
+static inline double Millis(Clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Sprite sheet xml
+struct SubTexture
+{
+	int x, y, width, height;
+	int frameX, frameY, frameWidth, frameHeight;
+
+	bool operator==(SubTexture _x) const
+	{ return x == _x.x && y == _x.y; }
+};
+
+class SpriteSheetXml
+{
+	public:
+		// Document
+		tinyxml2::XMLDocument doc;
+
+		// Image
+		Image image;
+
+		// Sprite sheet
+		std::map<std::string, SubTexture> subtextures;
+
+	public:
+		// Sprite sheet xml functions
+		// Without decode, only the subtextures are read
+		SpriteSheetXml(std::string name, bool decode = true);
+};
+
+// Sprite sheets shared between several xmls, so each sheet is only decoded once
+class SheetCache
+{
+	private:
+		// Open sheets by normalized path
+		std::map<std::string, std::shared_ptr<SpriteSheetXml>> sheets;
+		std::map<std::string, unsigned> uses;
+		std::mutex mutex;
+
+		static std::string Key(std::string name);
+
+	public:
+		// Statistics
+		unsigned hits = 0, misses = 0;
+
+	public:
+		// Sheet cache functions
+		// Once a sheet has been opened as many times as expected, the cache lets go of it
+		// so it is freed as soon as its last xml is done with it
+		void Expect(std::string name);
+		std::shared_ptr<SpriteSheetXml> Open(std::string name);
+};
+
+// Options
+struct Options
+{
+	unsigned jobs = 0;
+	std::string cache_dir;
+	double compress_budget = 16.0; // Cycles each byte saved is worth, for compress="auto"
+	bool uncompressed = false; // Ignore the xmls' compress attribute, for tools that compress the DMAs themselves
+	SheetCache *sheets = nullptr;
+};
+
+// Reads the sheet path of a character or sprite xml without compiling it
+std::string GetSheetName(std::string name);
+
+// Frame sizes of a character or sprite xml as they will be compiled, read without decoding its sheet
+struct XmlLayout
+{
+	bool highbpp = false, singleclut = false, tiled = false;
+
+	struct Frame
+	{
+		int w = 0, h = 0; // 0 for frames without a source
+	};
+	std::vector<Frame> frames;
+};
+
+XmlLayout MeasureXml(std::string name);
+
+// VRAM placement of every frame, overriding the xml's tx/ty/cx/cy
+struct Placement
+{
+	struct Frame
+	{
+		int tx = 0, ty = 0, cx = 0, cy = 0;
+	};
+	std::vector<Frame> frames;
+};
+
+// Character process xml
+// T is Mesh for .chr files and Sprites for .spr files
+template <typename T>
+class CharacterXml
+{
+	public:
+		// Document
+		tinyxml2::XMLDocument doc;
+
+		// Compiled frames
+		std::vector<T> frames;
+
+	public:
+		// Character xml functions
+		// Without chr_name or msh_name, the frames are only compiled
+		CharacterXml(std::string name, const char *chr_name, const char *msh_name, const char *dma_name, const Options &options, const Placement *placement = nullptr);
+};
+
+extern template class CharacterXml<Mesh>;
+extern template class CharacterXml<Sprites>;
@@ -24,6 +24,8 @@
 #include <stddef.h>
 #include <stdlib.h>
 
+#include "matchfinder.h"
+
 #define CLOWNLZSS_MIN(a, b) ((a) < (b) ? (a) : (b))
 #define CLOWNLZSS_MAX(a, b) ((a) > (b) ? (a) : (b))
 
@@ -39,29 +41,55 @@ typedef struct ClownLZSS_GraphEdge
 	size_t match_offset;
 } ClownLZSS_GraphEdge;
 
+/* Buffers of a compression function, kept between calls so they're only allocated once.
+   A context may only be used by one thread at a time. */
+typedef struct ClownLZSS_Context
+{
+	ClownLZSS_MatchFinder match_finder;
+	ClownLZSS_GraphEdge *node_meta_array;
+	size_t node_capacity;
+} ClownLZSS_Context;
+
+void ClownLZSS_Context_Init(ClownLZSS_Context *context);
+void ClownLZSS_Context_Destroy(ClownLZSS_Context *context);
+
+/* Matches are found with a suffix array rather than by walking every earlier string, which is near quadratic on repetitive data.
+   Only matches longer than every more recent one are tried: the framework keeps the first of equally cheap edges, and a more
+   recent match of the same length is never more expensive, so the graph and its output are the same as walking them all. */
 #define CLOWNLZSS_MAKE_COMPRESSION_FUNCTION(NAME, BYTES_PER_VALUE, MAX_MATCH_LENGTH, MAX_MATCH_DISTANCE, FIND_EXTRA_MATCHES, LITERAL_COST, LITERAL_CALLBACK, MATCH_COST_CALLBACK, MATCH_CALLBACK)\
-void NAME(const unsigned char *data, size_t data_size, void *user)\
+void NAME(ClownLZSS_Context *context, const unsigned char *data, size_t data_size, void *user)\
 {\
+	ClownLZSS_Context local_context;\
 	ClownLZSS_GraphEdge *node_meta_array;\
+	ClownLZSS_MatchFinder *match_finder;\
 	size_t i;\
 \
 	const size_t total_values = data_size / BYTES_PER_VALUE;\
 	const size_t DUMMY = -1;\
 \
-	/* String list stuff */\
-	size_t next[MAX_MATCH_DISTANCE + 0x100];\
-	size_t prev[MAX_MATCH_DISTANCE];\
-	size_t bytes[MAX_MATCH_DISTANCE];\
+	/* Without a context, use one just for this call */\
+	if (context == NULL)\
+	{\
+		ClownLZSS_Context_Init(&local_context);\
+		context = &local_context;\
+	}\
 \
-	/* Initialise the string list heads */\
-	for (i = 0; i < 0x100; ++i)\
-		next[MAX_MATCH_DISTANCE + i] = DUMMY;\
+	if (context->node_capacity < total_values + 1)	/* +1 for the end-node */\
+	{\
+		free(context->node_meta_array);\
+		context->node_meta_array = (ClownLZSS_GraphEdge*)malloc((total_values + 1) * sizeof(ClownLZSS_GraphEdge));\
+		context->node_capacity = context->node_meta_array != NULL ? total_values + 1 : 0;\
+	}\
 \
-	/* Initialise the string list nodes */\
-	for (i = 0; i < MAX_MATCH_DISTANCE; ++i)\
-		prev[i] = DUMMY;\
+	node_meta_array = context->node_meta_array;\
+	match_finder = &context->match_finder;\
 \
-	node_meta_array = (ClownLZSS_GraphEdge*)malloc((total_values + 1) * sizeof(ClownLZSS_GraphEdge));	/* +1 for the end-node */\
+	if (node_meta_array == NULL || !ClownLZSS_MatchFinder_Build(match_finder, data, total_values, BYTES_PER_VALUE))\
+	{\
+		if (context == &local_context)\
+			ClownLZSS_Context_Destroy(&local_context);\
+		return;\
+	}\
 \
 	/* Set costs to maximum possible value, so later comparisons work */\
 	node_meta_array[0].u.cost = 0;\
@@ -76,52 +104,38 @@ void NAME(const unsigned char *data, size_t data_size, void *user)\
 	/* Advance through the data one step at a time */\
 	for (i = 0; i < total_values; ++i)\
 	{\
-		size_t match_string;\
-\
-		const size_t string_list_head = MAX_MATCH_DISTANCE + (data[i * BYTES_PER_VALUE] & 0xFF);\
-		const size_t current_string = i % MAX_MATCH_DISTANCE;\
+		const size_t max_length = CLOWNLZSS_MIN(MAX_MATCH_LENGTH, total_values - i);\
+		const size_t window_start = i < (MAX_MATCH_DISTANCE) ? 0 : i - (MAX_MATCH_DISTANCE);\
+		size_t match_position, match_length;\
+		size_t length = 1 + (BYTES_PER_VALUE == 1);	/* Single byte values are already known to match their first byte */\
 \
 		FIND_EXTRA_MATCHES(data, total_values, i * BYTES_PER_VALUE, node_meta_array, user);\
 \
-		/* `string_list_head` points to a linked-list of strings in the LZSS sliding window that match at least
-		   one byte with the current string: iterate over it and generate every possible match for this string */\
-		for (match_string = next[string_list_head]; match_string != DUMMY; match_string = next[match_string])\
+		/* Walk back through the strings in the LZSS sliding window that match more values than any later one,
+		   and generate the runs that only they reach */\
+		while (length <= max_length && ClownLZSS_MatchFinder_Find(match_finder, i, length, window_start, &match_position, &match_length))\
 		{\
 			size_t j;\
 \
-			const unsigned char *current_bytes = &data[i * BYTES_PER_VALUE];\
-			const unsigned char *match_bytes = &data[bytes[match_string] * BYTES_PER_VALUE];\
+			match_length = CLOWNLZSS_MIN(match_length, max_length);\
 \
-			/* If `BYTES_PER_VALUE` is not 1, then we have to re-evaluate the first value, otherwise we can skip it */\
-			for (j = BYTES_PER_VALUE == 1; j < CLOWNLZSS_MIN(MAX_MATCH_LENGTH, total_values - i); ++j)\
+			for (j = length - 1; j < match_length; ++j)\
 			{\
-				unsigned int values_do_not_match = 0;\
-				size_t l;\
+				/* Figure out how much it costs to encode the current run */\
+				const size_t cost = MATCH_COST_CALLBACK(i - match_position, j + 1, user);\
 \
-				for (l = 0; l < BYTES_PER_VALUE; ++l)\
-					values_do_not_match |= current_bytes[j * BYTES_PER_VALUE + l] != match_bytes[j * BYTES_PER_VALUE + l];\
-\
-				if (values_do_not_match)\
-				{\
-					/* No match: give up on the current run */\
-					break;\
-				}\
-				else\
+				/* Figure out if the cost is lower than that of any other runs that end at the same value as this one */\
+				if (cost && node_meta_array[i + j + 1].u.cost > node_meta_array[i].u.cost + cost)\
 				{\
-					/* Figure out how much it costs to encode the current run */\
-					const size_t cost = MATCH_COST_CALLBACK((current_bytes - match_bytes) / (BYTES_PER_VALUE), j + 1, user);\
-\
-					/* Figure out if the cost is lower than that of any other runs that end at the same value as this one */\
-					if (cost && node_meta_array[i + j + 1].u.cost > node_meta_array[i].u.cost + cost)\
-					{\
-						/* Record this new best run in the graph edge assigned to the value at the end of the run */\
-						node_meta_array[i + j + 1].u.cost = node_meta_array[i].u.cost + cost;\
-						node_meta_array[i + j + 1].previous_node_index = i;\
-						node_meta_array[i + j + 1].match_length = j + 1;\
-						node_meta_array[i + j + 1].match_offset = bytes[match_string];\
-					}\
+					/* Record this new best run in the graph edge assigned to the value at the end of the run */\
+					node_meta_array[i + j + 1].u.cost = node_meta_array[i].u.cost + cost;\
+					node_meta_array[i + j + 1].previous_node_index = i;\
+					node_meta_array[i + j + 1].match_length = j + 1;\
+					node_meta_array[i + j + 1].match_offset = match_position;\
 				}\
 			}\
+\
+			length = match_length + 1;\
 		}\
 \
 		/* If a literal match is more efficient than all runs assigned to this value, then use that instead */\
@@ -132,26 +146,8 @@ void NAME(const unsigned char *data, size_t data_size, void *user)\
 			node_meta_array[i + 1].match_length = 0;\
 		}\
 \
-		/* Replace the oldest string in the list with the new string, since it's about to be pushed out of the LZSS sliding window */\
-\
-		/* Detach the old node in this slot */\
-		if (prev[current_string] != DUMMY)\
-		{\
-			next[prev[current_string]] = next[current_string];\
-\
-			if (next[current_string] != DUMMY)\
-				prev[next[current_string]] = prev[current_string];\
-		}\
-\
-		/* Replace the old node with this new one, and insert it at the start of its matching list */\
-		bytes[current_string] = i;\
-		prev[current_string] = string_list_head;\
-		next[current_string] = next[string_list_head];\
-\
-		if (next[string_list_head] != DUMMY)\
-			prev[next[string_list_head]] = current_string;\
-\
-		next[string_list_head] = current_string;\
+		/* This string can now be matched by the ones after it */\
+		ClownLZSS_MatchFinder_Insert(match_finder, i);\
 	}\
 \
 	/* At this point, the edges will have formed a shortest-path from the start to the end:
@@ -178,7 +174,8 @@ void NAME(const unsigned char *data, size_t data_size, void *user)\
 			MATCH_CALLBACK(next_index - length - offset, length, offset, user);\
 	}\
 \
-	free(node_meta_array);\
+	if (context == &local_context)\
+		ClownLZSS_Context_Destroy(&local_context);\
 }
 
 #endif /* CLOWNLZSS_H */
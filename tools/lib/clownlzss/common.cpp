@@ -23,8 +23,24 @@
 #include <stddef.h>
 #include <stdlib.h>
 
+#include "clownlzss.h"
 #include "memory_stream.h"
 
+void ClownLZSS_Context_Init(ClownLZSS_Context *context)
+{
+	ClownLZSS_MatchFinder_Init(&context->match_finder);
+	context->node_meta_array = NULL;
+	context->node_capacity = 0;
+}
+
+void ClownLZSS_Context_Destroy(ClownLZSS_Context *context)
+{
+	ClownLZSS_MatchFinder_Destroy(&context->match_finder);
+	free(context->node_meta_array);
+	context->node_meta_array = NULL;
+	context->node_capacity = 0;
+}
+
 unsigned char* RegularWrapper(const unsigned char *data, size_t data_size, size_t *compressed_size, void *user_data, void (*function)(const unsigned char *data, size_t data_size, MemoryStream *output_stream, void *user_data))
 {
 	MemoryStream output_stream;
@@ -134,14 +134,12 @@ static void ComperCompressStream(const unsigned char *data, size_t data_size, Me
 {
 	ComperInstance instance;
 
-	(void)user;
-
 	instance.output_stream = output_stream;
 	MemoryStream_Create(&instance.match_stream, cc_true);
 	instance.descriptor = 0;
 	instance.descriptor_bits_remaining = TOTAL_DESCRIPTOR_BITS;
 
-	CompressData(data, data_size, &instance);
+	CompressData((ClownLZSS_Context*)user, data, data_size, &instance);
 
 	/* Terminator match */
 	PutDescriptorBit(&instance, 1);
@@ -161,7 +159,72 @@ unsigned char* ClownLZSS_ComperCompress(const unsigned char *data, size_t data_s
 	return RegularWrapper(data, data_size, compressed_size, NULL, ComperCompressStream);
 }
 
+unsigned char* ClownLZSS_ComperCompressWithContext(ClownLZSS_Context *context, const unsigned char *data, size_t data_size, size_t *compressed_size)
+{
+	return RegularWrapper(data, data_size, compressed_size, context, ComperCompressStream);
+}
+
 unsigned char* ClownLZSS_ModuledComperCompress(const unsigned char *data, size_t data_size, size_t *compressed_size, size_t module_size)
 {
 	return ModuledCompressionWrapper(data, data_size, compressed_size, NULL, ComperCompressStream, module_size, 1);
 }
+
+static unsigned long ReadWord(const unsigned char *in)
+{
+	return ((unsigned long)in[0] << (8 * 0)) | ((unsigned long)in[1] << (8 * 1)) | ((unsigned long)in[2] << (8 * 2)) | ((unsigned long)in[3] << (8 * 3));
+}
+
+cc_bool ClownLZSS_ComperDecompress(const unsigned char *in, size_t in_size, unsigned char *out, size_t out_size)
+{
+	const unsigned char *in_end = in + in_size;
+	size_t out_position = 0;
+
+	for (;;)
+	{
+		unsigned long descriptor;
+		unsigned int bit;
+
+		/* Descriptor, its most significant bit first */
+		if (in_end - in < 4)
+			return cc_false;
+		descriptor = ReadWord(in);
+		in += 4;
+
+		for (bit = 0; bit < TOTAL_DESCRIPTOR_BITS; ++bit)
+		{
+			unsigned long word;
+			size_t distance, length;
+
+			if (in_end - in < 4)
+				return cc_false;
+			word = ReadWord(in);
+			in += 4;
+
+			/* Literal */
+			if ((descriptor & (0x80000000UL >> bit)) == 0)
+			{
+				if (out_size - out_position < 4)
+					return cc_false;
+				out[out_position++] = (word >> (8 * 0)) & 0xFF;
+				out[out_position++] = (word >> (8 * 1)) & 0xFF;
+				out[out_position++] = (word >> (8 * 2)) & 0xFF;
+				out[out_position++] = (word >> (8 * 3)) & 0xFF;
+				continue;
+			}
+
+			/* Terminator */
+			if (word == 0)
+				return out_position == out_size;
+
+			/* Match, the low half is the negated distance in bytes and the high half the length in words minus one
+			   The decoder copies whole words with lw, so it would fault on a distance that isn't a multiple of 4
+			   A distance of 4 repeats the last word written, which it keeps in a register rather than reading back */
+			distance = 0x10000 - (word & 0xFFFF);
+			length = ((word >> 16) + 1) * 4;
+			if ((distance & 3) != 0 || distance > out_position || length > out_size - out_position)
+				return cc_false;
+			for (; length != 0; --length, ++out_position)
+				out[out_position] = out[out_position - distance];
+		}
+	}
+}
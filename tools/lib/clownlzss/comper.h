@@ -23,7 +23,16 @@
 
 #include <stddef.h>
 
+#include "clowncommon.h"
+
+#include "clownlzss.h"
+
 unsigned char* ClownLZSS_ComperCompress(const unsigned char *data, size_t data_size, size_t *compressed_size);
+unsigned char* ClownLZSS_ComperCompressWithContext(ClownLZSS_Context *context, const unsigned char *data, size_t data_size, size_t *compressed_size);
 unsigned char* ClownLZSS_ModuledComperCompress(const unsigned char *data, size_t data_size, size_t *compressed_size, size_t module_size);
 
+/* Reference decoder, matching Compress::Decompress on every stream it accepts and checked against both buffers' sizes
+   Returns whether the stream was valid and decoded to exactly out_size bytes */
+cc_bool ClownLZSS_ComperDecompress(const unsigned char *in, size_t in_size, unsigned char *out, size_t out_size);
+
 #endif /* CLOWNLZSS_COMPER_H */
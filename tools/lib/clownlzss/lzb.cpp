@@ -0,0 +1,191 @@
+/*
+	(C) 2018-2021 Clownacy
+	This software is provided 'as-is', without any express or implied
+	warranty.  In no event will the authors be held liable for any damages
+	arising from the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	1. The origin of this software must not be misrepresented; you must not
+	   claim that you wrote the original software. If you use this software
+	   in a product, an acknowledgment in the product documentation would be
+	   appreciated but is not required.
+	2. Altered source versions must be plainly marked as such, and must not be
+	   misrepresented as being the original software.
+	3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* LZB format, see lzb.h */
+
+#include "lzb.h"
+
+#include <stddef.h>
+
+#include "clowncommon.h"
+
+#include "clownlzss.h"
+#include "common.h"
+#include "memory_stream.h"
+
+#define NIBBLE_EXTENDED 15
+
+typedef struct LZBInstance
+{
+	MemoryStream *output_stream;
+	MemoryStream literal_stream;
+} LZBInstance;
+
+static size_t GetExtensionBytes(size_t value)
+{
+	return value < NIBBLE_EXTENDED ? 0 : (value - NIBBLE_EXTENDED) / 0xFF + 1;
+}
+
+static void PutExtension(LZBInstance *instance, size_t value)
+{
+	if (value < NIBBLE_EXTENDED)
+		return;
+
+	for (value -= NIBBLE_EXTENDED; value >= 0xFF; value -= 0xFF)
+		MemoryStream_WriteByte(instance->output_stream, 0xFF);
+	MemoryStream_WriteByte(instance->output_stream, value);
+}
+
+static void PutSequence(LZBInstance *instance, size_t distance, size_t length)
+{
+	/* The literals waiting for a match go out in front of it */
+	const size_t literals = MemoryStream_GetPosition(&instance->literal_stream);
+	const size_t match = length != 0 ? length - LZB_MIN_MATCH : 0;
+
+	MemoryStream_WriteByte(instance->output_stream, (CC_MIN(literals, NIBBLE_EXTENDED) << 4) | CC_MIN(match, NIBBLE_EXTENDED));
+	PutExtension(instance, literals);
+	MemoryStream_Write(instance->output_stream, MemoryStream_GetBuffer(&instance->literal_stream), 1, literals);
+	MemoryStream_Rewind(&instance->literal_stream);
+
+	MemoryStream_WriteByte(instance->output_stream, (distance >> 0) & 0xFF);
+	MemoryStream_WriteByte(instance->output_stream, (distance >> 8) & 0xFF);
+	if (length != 0)
+		PutExtension(instance, match);
+}
+
+static void DoLiteral(const unsigned char *value, void *user)
+{
+	LZBInstance *instance = (LZBInstance*)user;
+
+	MemoryStream_WriteByte(&instance->literal_stream, value[0]);
+}
+
+static void DoMatch(size_t distance, size_t length, size_t offset, void *user)
+{
+	LZBInstance *instance = (LZBInstance*)user;
+
+	(void)offset;
+
+	PutSequence(instance, distance, length);
+}
+
+static size_t GetMatchCost(size_t distance, size_t length, void *user)
+{
+	(void)distance;
+	(void)user;
+
+	/* Costs are in bits, the token and offset are charged to the match as every sequence has one */
+
+	if (length < LZB_MIN_MATCH)
+		return 0;
+	else
+		return (1 + 2 + GetExtensionBytes(length - LZB_MIN_MATCH)) * 8;
+}
+
+static void FindExtraMatches(const unsigned char *data, size_t data_size, size_t offset, ClownLZSS_GraphEdge *node_meta_array, void *user)
+{
+	(void)data;
+	(void)data_size;
+	(void)offset;
+	(void)node_meta_array;
+	(void)user;
+}
+
+static CLOWNLZSS_MAKE_COMPRESSION_FUNCTION(CompressData, 1, 0x400, LZB_MAX_DISTANCE, FindExtraMatches, 8, DoLiteral, GetMatchCost, DoMatch)
+
+static void LZBCompressStream(const unsigned char *data, size_t data_size, MemoryStream *output_stream, void *user)
+{
+	LZBInstance instance;
+
+	instance.output_stream = output_stream;
+	MemoryStream_Create(&instance.literal_stream, cc_true);
+
+	CompressData((ClownLZSS_Context*)user, data, data_size, &instance);
+
+	/* Terminator sequence, the remaining literals followed by an offset of 0 */
+	PutSequence(&instance, 0, 0);
+
+	MemoryStream_Destroy(&instance.literal_stream);
+}
+
+unsigned char* ClownLZSS_LZBCompress(const unsigned char *data, size_t data_size, size_t *compressed_size)
+{
+	return RegularWrapper(data, data_size, compressed_size, NULL, LZBCompressStream);
+}
+
+unsigned char* ClownLZSS_LZBCompressWithContext(ClownLZSS_Context *context, const unsigned char *data, size_t data_size, size_t *compressed_size)
+{
+	return RegularWrapper(data, data_size, compressed_size, context, LZBCompressStream);
+}
+
+static cc_bool GetLength(const unsigned char **in, const unsigned char *in_end, size_t *length)
+{
+	unsigned int byte;
+
+	if (*length != NIBBLE_EXTENDED)
+		return cc_true;
+
+	do
+	{
+		if (*in == in_end)
+			return cc_false;
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == 0xFF);
+
+	return cc_true;
+}
+
+cc_bool ClownLZSS_LZBDecompress(const unsigned char *in, size_t in_size, unsigned char *out, size_t out_size)
+{
+	const unsigned char *in_end = in + in_size;
+	size_t out_position = 0;
+
+	for (;;)
+	{
+		size_t literals, length, distance;
+
+		/* Token */
+		if (in == in_end)
+			return cc_false;
+		literals = *in >> 4;
+		length = *in++ & 0xF;
+
+		/* Literals */
+		if (!GetLength(&in, in_end, &literals) || literals > (size_t)(in_end - in) || literals > out_size - out_position)
+			return cc_false;
+		for (; literals != 0; --literals)
+			out[out_position++] = *in++;
+
+		/* Offset */
+		if (in_end - in < 2)
+			return cc_false;
+		distance = in[0] | (in[1] << 8);
+		in += 2;
+		if (distance == 0)
+			return out_position == out_size;
+
+		/* Match, copied a byte at a time as it may overlap itself */
+		if (!GetLength(&in, in_end, &length))
+			return cc_false;
+		length += LZB_MIN_MATCH;
+		if (distance > out_position || length > out_size - out_position)
+			return cc_false;
+		for (; length != 0; --length, ++out_position)
+			out[out_position] = out[out_position - distance];
+	}
+}
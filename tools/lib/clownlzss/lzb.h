@@ -0,0 +1,53 @@
+/*
+	(C) 2018-2021 Clownacy
+
+	This software is provided 'as-is', without any express or implied
+	warranty.  In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+
+	1. The origin of this software must not be misrepresented; you must not
+	   claim that you wrote the original software. If you use this software
+	   in a product, an acknowledgment in the product documentation would be
+	   appreciated but is not required.
+	2. Altered source versions must be plainly marked as such, and must not be
+	   misrepresented as being the original software.
+	3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* LZB, a byte aligned LZ77 format in the style of LZ4, decoded by Compress::DecompressLZB
+
+   Comper works on whole words, so it can't see the byte level repetition of 4bpp textures.
+   LZB is a stream of sequences, each some literal bytes followed by a match:
+
+	token:          literal length in the high nibble, match length minus LZB_MIN_MATCH in the low nibble
+	[extension]:    if the literal length nibble is 15, bytes added to it until one isn't 255
+	literals
+	offset:         16-bit little endian distance back to the match, 0 ending the stream after the literals
+	[extension]:    if the match length nibble is 15, bytes added to it until one isn't 255
+
+   Matches may overlap what they write, so an offset of 1 repeats a byte. */
+
+#ifndef CLOWNLZSS_LZB_H
+#define CLOWNLZSS_LZB_H
+
+#include <stddef.h>
+
+#include "clowncommon.h"
+
+#include "clownlzss.h"
+
+#define LZB_MIN_MATCH 4
+#define LZB_MAX_DISTANCE 0xFFFF
+
+unsigned char* ClownLZSS_LZBCompress(const unsigned char *data, size_t data_size, size_t *compressed_size);
+unsigned char* ClownLZSS_LZBCompressWithContext(ClownLZSS_Context *context, const unsigned char *data, size_t data_size, size_t *compressed_size);
+
+/* Reference decoder, checked against both buffers' sizes
+   Returns whether the stream was valid and decoded to exactly out_size bytes */
+cc_bool ClownLZSS_LZBDecompress(const unsigned char *in, size_t in_size, unsigned char *out, size_t out_size);
+
+#endif /* CLOWNLZSS_LZB_H */
@@ -0,0 +1,296 @@
+/*
+	(C) 2018-2021 Clownacy
+
+	This software is provided 'as-is', without any express or implied
+	warranty.  In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+
+	1. The origin of this software must not be misrepresented; you must not
+	   claim that you wrote the original software. If you use this software
+	   in a product, an acknowledgment in the product documentation would be
+	   appreciated but is not required.
+	2. Altered source versions must be plainly marked as such, and must not be
+	   misrepresented as being the original software.
+	3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Suffix array match finder, replacing the per-byte string lists the original framework walked */
+
+#include "matchfinder.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clowncommon.h"
+
+typedef struct ValueKey
+{
+	unsigned long long key;
+	unsigned int position;
+} ValueKey;
+
+static int CompareValueKeys(const void *a, const void *b)
+{
+	const ValueKey *key_a = (const ValueKey*)a;
+	const ValueKey *key_b = (const ValueKey*)b;
+
+	if (key_a->key != key_b->key)
+		return key_a->key < key_b->key ? -1 : 1;
+	return 0;
+}
+
+static unsigned int RangeMinimum(const ClownLZSS_MatchFinder *finder, size_t first, size_t last)
+{
+	/* Minimum of lcp[first..last], from the two overlapping power of two rows that cover it */
+	size_t row = 0;
+	unsigned int a, b;
+
+	while (((size_t)2 << row) <= last - first + 1)
+		++row;
+
+	a = finder->lcp_minimum[row * finder->total_values + first];
+	b = finder->lcp_minimum[row * finder->total_values + last + 1 - ((size_t)1 << row)];
+	return CC_MIN(a, b);
+}
+
+void ClownLZSS_MatchFinder_Init(ClownLZSS_MatchFinder *finder)
+{
+	finder->total_values = 0;
+	finder->log2_values = 1;
+
+	finder->suffix_array = NULL;
+	finder->rank = NULL;
+	finder->lcp = NULL;
+	finder->lcp_minimum = NULL;
+	finder->inserted = NULL;
+
+	finder->keys = NULL;
+	finder->second = NULL;
+	finder->count = NULL;
+	finder->new_rank = NULL;
+
+	finder->capacity = 0;
+}
+
+void ClownLZSS_MatchFinder_Destroy(ClownLZSS_MatchFinder *finder)
+{
+	free(finder->suffix_array);
+	free(finder->rank);
+	free(finder->lcp);
+	free(finder->lcp_minimum);
+	free(finder->inserted);
+
+	free(finder->keys);
+	free(finder->second);
+	free(finder->count);
+	free(finder->new_rank);
+
+	ClownLZSS_MatchFinder_Init(finder);
+}
+
+static cc_bool Reserve(ClownLZSS_MatchFinder *finder, size_t total_values)
+{
+	size_t log2_values = 1;
+
+	if (total_values <= finder->capacity && finder->suffix_array != NULL)
+		return cc_true;
+
+	while (((size_t)1 << log2_values) < total_values)
+		++log2_values;
+
+	ClownLZSS_MatchFinder_Destroy(finder);
+
+	finder->suffix_array = (unsigned int*)malloc((total_values + 1) * sizeof(unsigned int));
+	finder->rank = (unsigned int*)malloc((total_values + 1) * sizeof(unsigned int));
+	finder->lcp = (unsigned int*)malloc((total_values + 1) * sizeof(unsigned int));
+	finder->lcp_minimum = (unsigned int*)malloc((log2_values * total_values + 1) * sizeof(unsigned int));
+	finder->inserted = (unsigned int*)malloc(((size_t)2 << log2_values) * sizeof(unsigned int));
+
+	finder->keys = malloc((total_values + 1) * sizeof(ValueKey));
+	finder->second = (unsigned int*)malloc((total_values + 1) * sizeof(unsigned int));
+	finder->count = (unsigned int*)malloc((total_values + 1) * sizeof(unsigned int));
+	finder->new_rank = (unsigned int*)malloc((total_values + 1) * sizeof(unsigned int));
+
+	if (finder->suffix_array == NULL || finder->rank == NULL || finder->lcp == NULL || finder->lcp_minimum == NULL || finder->inserted == NULL
+	 || finder->keys == NULL || finder->second == NULL || finder->count == NULL || finder->new_rank == NULL)
+	{
+		ClownLZSS_MatchFinder_Destroy(finder);
+		return cc_false;
+	}
+
+	finder->capacity = total_values;
+	return cc_true;
+}
+
+cc_bool ClownLZSS_MatchFinder_Build(ClownLZSS_MatchFinder *finder, const unsigned char *data, size_t total_values, size_t bytes_per_value)
+{
+	ValueKey *keys;
+	unsigned int *second, *count, *new_rank;
+	size_t i, j, k, classes;
+
+	assert(bytes_per_value <= sizeof(keys->key));
+
+	if (!Reserve(finder, total_values))
+		return cc_false;
+
+	finder->total_values = total_values;
+	finder->log2_values = 1;
+	while (((size_t)1 << finder->log2_values) < total_values)
+		++finder->log2_values;
+
+	memset(finder->inserted, 0, ((size_t)2 << finder->log2_values) * sizeof(unsigned int));
+
+	keys = (ValueKey*)finder->keys;
+	second = finder->second;
+	count = finder->count;
+	new_rank = finder->new_rank;
+
+	/* Rank the values themselves */
+	for (i = 0; i < total_values; ++i)
+	{
+		keys[i].key = 0;
+		for (j = 0; j < bytes_per_value; ++j)
+			keys[i].key = (keys[i].key << 8) | data[i * bytes_per_value + j];
+		keys[i].position = (unsigned int)i;
+	}
+
+	qsort(keys, total_values, sizeof(ValueKey), CompareValueKeys);
+
+	classes = 0;
+	for (i = 0; i < total_values; ++i)
+	{
+		if (i == 0 || keys[i].key != keys[i - 1].key)
+			++classes;
+		finder->suffix_array[i] = keys[i].position;
+		finder->rank[keys[i].position] = (unsigned int)(classes - 1);
+	}
+
+	/* Double the sorted length until every suffix has its own rank */
+	for (k = 1; classes < total_values; k <<= 1)
+	{
+		/* Order by the rank k values ahead, with suffixes too short to have one first */
+		j = 0;
+		for (i = total_values - CC_MIN(k, total_values); i < total_values; ++i)
+			second[j++] = (unsigned int)i;
+		for (i = 0; i < total_values; ++i)
+			if (finder->suffix_array[i] >= k)
+				second[j++] = (unsigned int)(finder->suffix_array[i] - k);
+
+		/* Then stably by their own rank */
+		memset(count, 0, classes * sizeof(unsigned int));
+		for (i = 0; i < total_values; ++i)
+			++count[finder->rank[i]];
+		for (i = 1; i < classes; ++i)
+			count[i] += count[i - 1];
+		for (i = total_values; i-- > 0;)
+			finder->suffix_array[--count[finder->rank[second[i]]]] = second[i];
+
+		/* Rerank */
+		classes = 1;
+		new_rank[finder->suffix_array[0]] = 0;
+		for (i = 1; i < total_values; ++i)
+		{
+			const size_t a = finder->suffix_array[i - 1];
+			const size_t b = finder->suffix_array[i];
+			const size_t rank_a = a + k < total_values ? finder->rank[a + k] + 1 : 0;
+			const size_t rank_b = b + k < total_values ? finder->rank[b + k] + 1 : 0;
+
+			if (finder->rank[a] != finder->rank[b] || rank_a != rank_b)
+				++classes;
+			new_rank[b] = (unsigned int)(classes - 1);
+		}
+		memcpy(finder->rank, new_rank, total_values * sizeof(unsigned int));
+	}
+
+	/* Match lengths between neighbouring suffixes (Kasai's algorithm) */
+	k = 0;
+	for (i = 0; i < total_values; ++i)
+	{
+		if (finder->rank[i] == 0)
+		{
+			finder->lcp[0] = 0;
+			k = 0;
+			continue;
+		}
+
+		j = finder->suffix_array[finder->rank[i] - 1];
+		while (i + k < total_values && j + k < total_values && memcmp(&data[(i + k) * bytes_per_value], &data[(j + k) * bytes_per_value], bytes_per_value) == 0)
+			++k;
+		finder->lcp[finder->rank[i]] = (unsigned int)k;
+
+		if (k != 0)
+			--k;
+	}
+
+	/* Sparse table of their minimums */
+	if (total_values != 0)
+		memcpy(finder->lcp_minimum, finder->lcp, total_values * sizeof(unsigned int));
+	for (j = 1; j < finder->log2_values; ++j)
+	{
+		const unsigned int *row = &finder->lcp_minimum[(j - 1) * total_values];
+		unsigned int *next_row = &finder->lcp_minimum[j * total_values];
+
+		for (i = 0; i + ((size_t)1 << j) <= total_values; ++i)
+			next_row[i] = CC_MIN(row[i], row[i + ((size_t)1 << (j - 1))]);
+	}
+
+	return cc_true;
+}
+
+void ClownLZSS_MatchFinder_Insert(ClownLZSS_MatchFinder *finder, size_t position)
+{
+	/* Positions are inserted in order, so each one is the latest of every range it's in */
+	size_t node = ((size_t)1 << finder->log2_values) + finder->rank[position];
+
+	for (; node != 0; node >>= 1)
+		finder->inserted[node] = (unsigned int)(position + 1);
+}
+
+cc_bool ClownLZSS_MatchFinder_Find(const ClownLZSS_MatchFinder *finder, size_t position, size_t minimum_length, size_t window_start, size_t *match_position, size_t *match_length)
+{
+	const size_t rank = finder->rank[position];
+	const size_t leaves = (size_t)1 << finder->log2_values;
+	size_t first = rank, last = rank;
+	size_t row, left, right;
+	unsigned int latest = 0;
+
+	/* Widen to every suffix sharing at least minimum_length values with this one */
+	for (row = finder->log2_values; row-- > 0;)
+	{
+		const size_t step = (size_t)1 << row;
+		const unsigned int *lcp_minimum = &finder->lcp_minimum[row * finder->total_values];
+
+		if (last + step < finder->total_values && lcp_minimum[last + 1] >= minimum_length)
+			last += step;
+		if (first >= step && lcp_minimum[first + 1 - step] >= minimum_length)
+			first -= step;
+	}
+
+	/* Find the latest position among them */
+	for (left = first + leaves, right = last + leaves + 1; left < right; left >>= 1, right >>= 1)
+	{
+		if (left & 1)
+		{
+			latest = CC_MAX(latest, finder->inserted[left]);
+			++left;
+		}
+		if (right & 1)
+		{
+			--right;
+			latest = CC_MAX(latest, finder->inserted[right]);
+		}
+	}
+
+	if (latest == 0 || latest - 1 < window_start)
+		return cc_false;
+
+	*match_position = latest - 1;
+	*match_length = RangeMinimum(finder, CC_MIN(finder->rank[latest - 1], rank) + 1, CC_MAX(finder->rank[latest - 1], rank));
+	return cc_true;
+}
@@ -0,0 +1,62 @@
+/*
+	(C) 2018-2021 Clownacy
+
+	This software is provided 'as-is', without any express or implied
+	warranty.  In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+
+	1. The origin of this software must not be misrepresented; you must not
+	   claim that you wrote the original software. If you use this software
+	   in a product, an acknowledgment in the product documentation would be
+	   appreciated but is not required.
+	2. Altered source versions must be plainly marked as such, and must not be
+	   misrepresented as being the original software.
+	3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Suffix array match finder, replacing the per-byte string lists the original framework walked */
+
+#ifndef MATCHFINDER_H
+#define MATCHFINDER_H
+
+#include <stddef.h>
+
+#include "clowncommon.h"
+
+typedef struct ClownLZSS_MatchFinder
+{
+	size_t total_values;
+	size_t log2_values;
+
+	unsigned int *suffix_array;  /* Positions in sorted order */
+	unsigned int *rank;          /* Sorted order of each position */
+	unsigned int *lcp;           /* lcp[r] is the match length between suffix_array[r - 1] and suffix_array[r] */
+	unsigned int *lcp_minimum;   /* Sparse table of lcp minimums, log2_values rows of total_values */
+	unsigned int *inserted;      /* Segment tree of the latest inserted position in each rank range, plus one */
+
+	/* Sorting scratch */
+	void *keys;
+	unsigned int *second, *count, *new_rank;
+
+	/* Buffers are kept between builds and only grow */
+	size_t capacity;
+} ClownLZSS_MatchFinder;
+
+void ClownLZSS_MatchFinder_Init(ClownLZSS_MatchFinder *finder);
+void ClownLZSS_MatchFinder_Destroy(ClownLZSS_MatchFinder *finder);
+
+/* Indexes data, forgetting every inserted position */
+cc_bool ClownLZSS_MatchFinder_Build(ClownLZSS_MatchFinder *finder, const unsigned char *data, size_t total_values, size_t bytes_per_value);
+
+/* Makes position visible to later searches */
+void ClownLZSS_MatchFinder_Insert(ClownLZSS_MatchFinder *finder, size_t position);
+
+/* Finds the latest inserted position no earlier than window_start that matches at least minimum_length values at position,
+   returning it and its full match length */
+cc_bool ClownLZSS_MatchFinder_Find(const ClownLZSS_MatchFinder *finder, size_t position, size_t minimum_length, size_t window_start, size_t *match_position, size_t *match_length);
+
+#endif /* MATCHFINDER_H */